@@ -3,34 +3,94 @@
 #include <iostream>
 #include <cstdint>
 #include <iomanip>
+#include <array>
+#include <vector>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <random>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
 // ************************************************************************************
 
-const vector<vector<int8_t>> BOARD_LAYOUT = {
-    {'a', 'b', 'b', 'c', 'c', 'c'},
-    {'a', 'b', 'b', 'c', 'c', 'c'},
-    {'a', 'a', 'b', 'b', 'c', 'c'},
-    {'a', 'a', 'b', 'b', 'c', 'c'},
-    {'a', 'a', 'a', 'b', 'b', 'c'},
-    {'a', 'a', 'a', 'b', 'b', 'c'},
+/*
+ Board layouts, the region of every cell row by row from the top rank down. The board geometry is compiled
+ into the search for the layout it runs on, any square board up to 8x8 with the regions a, b and c works.
+ */
+struct KnightMoves6Layout {
+    static constexpr int8_t SIZE = 6;
+    static constexpr char REGIONS[] =
+        "abbccc"
+        "abbccc"
+        "aabbcc"
+        "aabbcc"
+        "aaabbc"
+        "aaabbc";
+};
+
+struct KnightMoves5Layout {
+    static constexpr int8_t SIZE = 5;
+    static constexpr char REGIONS[] =
+        "abbcc"
+        "abbcc"
+        "aabbc"
+        "aabbc"
+        "aaabc";
+};
+
+struct KnightMoves8Layout {
+    static constexpr int8_t SIZE = 8;
+    static constexpr char REGIONS[] =
+        "abbbcccc"
+        "abbbcccc"
+        "aabbbccc"
+        "aabbbccc"
+        "aaabbbcc"
+        "aaabbbcc"
+        "aaaabbbc"
+        "aaaabbbc";
 };
 
-const int8_t BOARD_SIZE = BOARD_LAYOUT.size();
 const size_t TARGET_SCORE = 2024;
 const int8_t DEFAULT_CELL_VALUE = -1;
 
+constexpr pair<int8_t, int8_t> KNIGHT_MOVES[] = {
+    {2, 1},
+    {1, 2},
+    {-1, 2},
+    {-2, 1},
+    {-2, -1},
+    {-1, -2},
+    {1, -2},
+    {2, -1},
+};
+
 // trying to target A B C as low as possible (plus all permutations)
 vector<int8_t> TARGET_ABC = {1,2,3};
 
-const pair<int8_t, int8_t> TRIP_A1F6_START = {5,0};
-const pair<int8_t, int8_t> TRIP_A1F6_FINISH = {0,5};
-
-const pair<int8_t, int8_t> TRIP_A6F1_START = {0,0};
-const pair<int8_t, int8_t> TRIP_A6F1_FINISH = {5,5};
+// slots of the two trips in the results table
+const int8_t TRIP_A6F1_DIRECTION = 0;
+const int8_t TRIP_A1F6_DIRECTION = 1;
 
 /*
  We need an even number of knight's moves, as diagonal corner cells share the same color,
@@ -40,13 +100,163 @@ const pair<int8_t, int8_t> TRIP_A6F1_FINISH = {5,5};
  the multiplication of the greatest target value we picked, which is 3.
  */
 const int8_t TRIP_LENGTH_MIN = 8;
-const int8_t TRIP_LENGTH_MAX = BOARD_SIZE * BOARD_SIZE - 1;
+
+/*
+ Number of trip lengths covered by one search pass. A knight changes the colour of its cell on every move, so only
+ one length of every two can reach the finish cell: the window of two only drops the passes of the wrong parity,
+ each pass still has a single reachable length. Only the trips of the shortest length of a window can be published
+ before the pass is over, so a wider window would lose the early exit.
+ */
+const int8_t TRIP_LENGTH_WINDOW = 2;
+
+// the search of a pass is split into independent subtrees, one per trip prefix of this many moves
+const int8_t TRIP_PREFIX_DEPTH = 4;
+
+// number of cached candidate scores of the region signatures per worker
+const size_t SIGNATURE_SCORES_MAX = 1 << 22;
+
+// longest trip whose region signature, a base 3 digit per cell after a leading 1, still fits 64 bits
+const int8_t SIGNATURE_LENGTH_MAX = 38;
+
+/*
+ Candidate scores are stepped this many at a time, with AVX-512 or AVX2 when the CPU supports them, picked at runtime,
+ scalar otherwise. Scores saturate at SCORE_LIMIT, which has to stay in 32 bits after a multiplication by any value.
+ */
+const size_t SCORE_LANES = 16;
+const uint32_t SCORE_LIMIT = TARGET_SCORE + 1;
+
+static_assert(uint64_t(SCORE_LIMIT) * INT8_MAX <= UINT32_MAX, "scores must fit 32 bit lanes");
 
 // ************************************************************************************
 
-unordered_map<size_t, vector<pair<int8_t, int8_t>>> valid_trips;
+/*
+ Cells are indexed as i * SIZE + j and the visited cells of a trip are kept as a single bit mask,
+ so the board must not have more than 64 cells.
+ */
+typedef uint64_t Bitboard;
+
+// all knight destinations for every cell of the board
+template<int8_t SIZE>
+constexpr array<Bitboard, SIZE * SIZE> generateKnightAttacks() {
+    array<Bitboard, SIZE * SIZE> r = {};
+    
+    for(int8_t i = 0; i < SIZE; ++i) {
+        for(int8_t j = 0; j < SIZE; ++j) {
+            for(const pair<int8_t, int8_t>& knight_move : KNIGHT_MOVES) {
+                int8_t next_i = i + knight_move.first, next_j = j + knight_move.second;
+                
+                if(next_i >= 0 && next_i < SIZE && next_j >= 0 && next_j < SIZE) {
+                    r[i * SIZE + j] |= Bitboard(1) << (next_i * SIZE + next_j);
+                }
+            }
+        }
+    }
+    
+    return r;
+}
+
+// region of every cell, 0 for 'a', 1 for 'b' and 2 for 'c'
+template<typename Layout>
+constexpr array<int8_t, Layout::SIZE * Layout::SIZE> generateCellRegions() {
+    array<int8_t, Layout::SIZE * Layout::SIZE> r = {};
+    for(int8_t cell = 0; cell < Layout::SIZE * Layout::SIZE; ++cell) r[cell] = Layout::REGIONS[cell] - 'a';
+    
+    return r;
+}
+
+// cells of every region as a bit mask
+template<size_t CELLS>
+constexpr array<Bitboard, 3> generateRegionMasks(const array<int8_t, CELLS>& cell_regions) {
+    array<Bitboard, 3> r = {};
+    
+    for(size_t cell = 0; cell < CELLS; ++cell) {
+        if(cell_regions[cell] >= 0 && cell_regions[cell] < 3) r[cell_regions[cell]] |= Bitboard(1) << cell;
+    }
+    
+    return r;
+}
+
+/*
+ Fewest knight moves between every two cells, found by a BFS over the empty board. Visited cells can only make a trip longer,
+ and any trip between two cells has the same parity as this distance, as every move changes the color of the cell.
+ */
+template<int8_t SIZE>
+constexpr array<array<int8_t, SIZE * SIZE>, SIZE * SIZE> generateKnightDistances(const array<Bitboard, SIZE * SIZE>& knight_attacks) {
+    array<array<int8_t, SIZE * SIZE>, SIZE * SIZE> r = {};
+    
+    for(int8_t from = 0; from < SIZE * SIZE; ++from) {
+        array<int8_t, SIZE * SIZE> queue = {};
+        size_t queue_size = 0;
+        
+        for(int8_t& distance : r[from]) distance = DEFAULT_CELL_VALUE;
+        
+        r[from][from] = 0;
+        queue[queue_size++] = from;
+        
+        for(size_t q = 0; q < queue_size; ++q) {
+            int8_t cell = queue[q];
+            
+            for(Bitboard moves = knight_attacks[cell]; moves; moves &= moves - 1) {
+                int8_t next_cell = __builtin_ctzll(moves);
+                if(r[from][next_cell] != DEFAULT_CELL_VALUE) continue;
+                
+                r[from][next_cell] = r[from][cell] + 1;
+                queue[queue_size++] = next_cell;
+            }
+        }
+    }
+    
+    return r;
+}
+
+/*
+ Everything the search needs to know about a board layout, generated at compile time. The search code is templated on it,
+ so the tables are constants of every instantiation and the 6x6 board doesn't pay for the others.
+ */
+template<typename Layout>
+struct BoardGeometry {
+    static constexpr int8_t SIZE = Layout::SIZE;
+    static constexpr int8_t CELLS = SIZE * SIZE;
+    
+    static_assert(SIZE >= 3 && CELLS <= 64, "the board must fit a Bitboard");
+    static_assert(sizeof(Layout::REGIONS) == size_t(CELLS) + 1, "the layout must have a region for every cell");
+    
+    // the corners the two trips run between, a6 f1 and a1 f6 on the 6x6 board
+    static constexpr int8_t TOP_LEFT = 0;
+    static constexpr int8_t TOP_RIGHT = SIZE - 1;
+    static constexpr int8_t BOTTOM_LEFT = CELLS - SIZE;
+    static constexpr int8_t BOTTOM_RIGHT = CELLS - 1;
+    
+    static constexpr int8_t TRIP_LENGTH_MAX = min<int8_t>(CELLS - 1, SIGNATURE_LENGTH_MAX);
+    
+    static constexpr array<Bitboard, CELLS> KNIGHT_ATTACKS = generateKnightAttacks<SIZE>();
+    static constexpr array<int8_t, CELLS> CELL_REGIONS = generateCellRegions<Layout>();
+    static constexpr array<Bitboard, 3> REGION_MASKS = generateRegionMasks(CELL_REGIONS);
+    static constexpr array<array<int8_t, CELLS>, CELLS> KNIGHT_DISTANCES = generateKnightDistances<SIZE>(KNIGHT_ATTACKS);
+    
+    static_assert(REGION_MASKS[0] + REGION_MASKS[1] + REGION_MASKS[2] == (~Bitboard(0) >> (64 - CELLS)), "every cell must be in region a, b or c");
+    
+    static constexpr int8_t cellIndex(const int8_t& i, const int8_t& j) {
+        return i * SIZE + j;
+    }
+    
+    // whether a trip which made move_count moves to get to the cell can still end on target_cell with a length in [length_min, length_max]
+    static bool canReach(const int8_t& target_cell, const int8_t& cell, const int8_t& move_count, const int8_t& length_min, const int8_t& length_max) {
+        int8_t length = move_count + KNIGHT_DISTANCES[target_cell][cell];
+        
+        // the first length of the window with the right parity
+        if(length < length_min) length += (length_min - length + 1) / 2 * 2;
+        
+        return length <= length_max;
+    }
+};
+
+typedef BoardGeometry<KnightMoves6Layout> KnightMoves6Board;
+typedef BoardGeometry<KnightMoves5Layout> KnightMoves5Board;
+typedef BoardGeometry<KnightMoves8Layout> KnightMoves8Board;
+
+// ************************************************************************************
 
-mutex valid_trips_mutex;
 mutex print_mutex;
 
 // ************************************************************************************
@@ -69,38 +279,48 @@ void printBoard(const vector<vector<int8_t>>& board) {
     cout << endl;
 }
 
-void printTrip(const vector<pair<int8_t, int8_t>>& trip) {
+template<typename Board>
+void printTrip(const vector<int8_t>& trip) {
     lock_guard<mutex> lock(print_mutex);
     int8_t trip_length = trip.size();
     if(trip_length > 0) {
-        for(int8_t i = 0; i < trip_length - 1; ++i) cout << char(trip[i].second + 'a') << int(BOARD_SIZE - trip[i].first) << ",";
-        cout << char(trip.back().second + 'a') << int(BOARD_SIZE - trip.back().first);
+        for(int8_t i = 0; i < trip_length - 1; ++i) cout << char(trip[i] % Board::SIZE + 'a') << int(Board::SIZE - trip[i] / Board::SIZE) << ",";
+        cout << char(trip.back() % Board::SIZE + 'a') << int(Board::SIZE - trip.back() / Board::SIZE);
     }
 }
 
 // ************************************************************************************
 
+/*
+ Values of A B C. The cells are mapped to their regions by the board geometry, so a candidate is the same
+ for every layout and scores trips from the regions of their cells.
+ */
 struct CandidateBoard {
 public:
     CandidateBoard(int8_t& a, int8_t& b, int8_t& c): a(a), b(b), c(c) {
         setMapKey();
-        fillLayout();
+        fillValues();
     }
     
-    bool isValidTrip(const vector<pair<int8_t, int8_t>>& trip_tracker, const int8_t& trip_length) {
-        size_t score = layout[trip_tracker[0].first][trip_tracker[0].second];
-        
-        for(int8_t i = 1; i <= trip_length; ++i) {
-            if(layout[trip_tracker[i-1].first][trip_tracker[i-1].second] == layout[trip_tracker[i].first][trip_tracker[i].second]) {
-                score += layout[trip_tracker[i].first][trip_tracker[i].second];
-            } else {
-                score *= layout[trip_tracker[i].first][trip_tracker[i].second];
-            }
-            
-            if(score > TARGET_SCORE) return false;
-        }
-        
-        return score == TARGET_SCORE;
+    // score of a trip which only visited its start cell
+    size_t startScore(const int8_t& region) {
+        return values[region];
+    }
+    
+    /*
+     Score of a trip after the move from prev_region to next_region: within the same region we add, otherwise multiply.
+     The values are positive so a score never decreases, once it is above the target we keep it at TARGET_SCORE + 1
+     as the exact value doesn't matter anymore and this way it can't overflow on long trips.
+     */
+    size_t stepScore(const size_t& score, const int8_t& prev_region, const int8_t& next_region) {
+        size_t r = prev_region == next_region ? score + values[next_region] : score * values[next_region];
+        return min(r, TARGET_SCORE + 1);
+    }
+    
+    // the same step as an affine function of the score, score * first + second
+    pair<size_t, size_t> stepFunction(const int8_t& prev_region, const int8_t& next_region) {
+        if(prev_region == next_region) return {1, values[next_region]};
+        return {values[next_region], 0};
     }
     
     // ************************************************************************************
@@ -124,171 +344,2244 @@ private:
     int8_t a, b, c;
     size_t map_key;
     
-    vector<vector<int8_t>> layout = BOARD_LAYOUT;
+    // value of every region, indexed the same way as the cell regions
+    int8_t values[3];
     
-    // good enough as our target is to find ABC as low as possible
+    // one byte per value, so it stays unique for any A B C we can sweep
     void setMapKey() {
-        map_key = a * 100 + b * 10 + c;
+        map_key = (size_t(a) << 16) | (size_t(b) << 8) | size_t(c);
     }
     
-    void fillLayout() {
-        for(vector<int8_t>& row : layout) {
-            for(int8_t& cell : row) {
-                switch(cell) {
-                    case 'a': cell = a; break;
-                    case 'b': cell = b; break;
-                    case 'c': cell = c; break;
-                }
-            }
-        }
+    void fillValues() {
+        values[0] = a;
+        values[1] = b;
+        values[2] = c;
     }
 };
 
 // ************************************************************************************
 
-void printResult(const int8_t& a, const int8_t& b, const int8_t& c, vector<pair<int8_t, int8_t>>& trip1, vector<pair<int8_t, int8_t>>& trip2) {
-    cout << "I found it!" << endl;
-    cout << static_cast<int>(a) << "," << static_cast<int>(b) << "," << static_cast<int>(c) << ",";
-    
-    if(trip1[0] == TRIP_A6F1_START) swap(trip1, trip2);
+// shared flag every worker polls, so the search winds down on its own once the answer is found
+struct StopToken {
+public:
+    void request() {
+        stopped.store(true, memory_order_relaxed);
+    }
     
-    printTrip(trip1);
-    cout << ",";
-    printTrip(trip2);
-    cout << endl;
-}
+    bool isRequested() const {
+        return stopped.load(memory_order_relaxed);
+    }
+private:
+    atomic<bool> stopped{false};
+};
 
 // ************************************************************************************
 
-struct TripsFinder {
+// a counter of a single thread, an increment is a plain load and store which the reporter thread can read at any time
+struct Counter {
+public:
+    void add(const size_t& n = 1) {
+        value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed);
+    }
+    
+    size_t get() const {
+        return value.load(memory_order_relaxed);
+    }
+private:
+    atomic<size_t> value{0};
+};
+
+// counters of one search worker, on cache lines of their own so the workers never write to a shared line
+struct alignas(64) SearchCounters {
+    Counter nodes, leaves;
+    
+    // branches cut as the finish is out of reach, as every candidate is above the target, and at the longest trip of the pass
+    Counter reach_prunes, score_prunes, length_prunes;
+};
+
+// the pass the search is in and how many of its prefix subtrees are done, for the progress reports and the checkpoints
+struct PassProgress {
+    atomic<int> length_min{0}, length_max{0};
+    atomic<size_t> tasks_done{0}, tasks_count{0};
+    atomic<int64_t> start_ns{0};
+    
+    // guards the pass for the checkpoints, which are only taken while the finders are in_pass or between two passes
+    mutex pass_mutex;
+    bool in_pass = false;
+    
+    // a flag per prefix subtree of the pass, set by the worker which searched it
+    vector<atomic<bool>> done_tasks;
+};
+
+/*
+ Calls run every interval_ms with the seconds elapsed since it was created, from its own thread, until it is destroyed.
+ The progress reports and the checkpoints run this way, so the workers never wait for them.
+ */
+class PeriodicThread {
 public:
-    TripsFinder(const pair<int8_t, int8_t>& start, const pair<int8_t, int8_t>& finish, const vector<CandidateBoard>& candidate_boards) {
-        start_i = start.first;
-        start_j = start.second;
+    PeriodicThread(const size_t& interval_ms, const function<void(const double&)>& run): interval_ms(interval_ms), run(run), start(chrono::steady_clock::now()) {
+        if(interval_ms > 0) reporter = thread([this]() { loop(); });
+    }
+    
+    ~PeriodicThread() {
+        if(!reporter.joinable()) return;
         
-        finish_i = finish.first;
-        finish_j = finish.second;
+        {
+            lock_guard<mutex> lock(stop_mutex);
+            stopped = true;
+        }
         
-        this->candidate_boards = candidate_boards;
-    };
+        stop_condition.notify_one();
+        reporter.join();
+    }
+private:
+    size_t interval_ms;
+    function<void(const double&)> run;
+    chrono::steady_clock::time_point start;
     
-    void run() {
-        while(trip_length <= TRIP_LENGTH_MAX) {
-            board = vector<vector<int8_t>>(BOARD_SIZE, vector<int8_t>(BOARD_SIZE, DEFAULT_CELL_VALUE));
-            
-            trip_tracker = vector<pair<int8_t, int8_t>>();
-            trip_tracker.reserve(trip_length + 1);
-            
-            board[start_i][start_j] = move_count;
-            trip_tracker.emplace_back(start_i, start_j);
+    thread reporter;
+    mutex stop_mutex;
+    condition_variable stop_condition;
+    bool stopped = false;
+    
+    void loop() {
+        unique_lock<mutex> lock(stop_mutex);
+        
+        while(!stop_condition.wait_for(lock, chrono::milliseconds(interval_ms), [this]() { return stopped; })) {
+            run(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        }
+    }
+};
+
+struct KnightMovesResult {
+    bool found = false;
+    int8_t a = 0, b = 0, c = 0;
+    vector<int8_t> trip_a1f6, trip_a6f1;
+    
+    // cells the depth-first search visited over all the workers
+    size_t nodes_count = 0;
+};
+
+/*
+ Trips published by both directions, with a fixed slot per candidate board. A direction publishes a candidate at most once,
+ so each trip of a slot has a single writer and is written before its direction bit is set. Whoever sets the second bit
+ of a slot has a match, and the first of them to swap its slot into the winner is the answer and stops the search.
+ As the passes go up in trip length, the answer is a candidate board matched by the shortest trips, not the one with
+ the lowest A + B + C or the first in the candidates order, and of the matches of the same length whichever comes first.
+ */
+struct ResultsTable {
+public:
+    ResultsTable(const vector<CandidateBoard>& candidate_boards, StopToken& stop_token): slots(candidate_boards.size()), stop_token(stop_token) {
+        for(size_t s = 0; s < candidate_boards.size(); ++s) {
+            CandidateBoard candidate = candidate_boards[s];
             
-            move(start_i, start_j);
-            trip_length++;
+            slots[s].a = candidate.getA();
+            slots[s].b = candidate.getB();
+            slots[s].c = candidate.getC();
+            slots_by_key.emplace(candidate.getMapKey(), s);
         }
     }
+    
+    void publish(const size_t& map_key, const int8_t& direction, const vector<int8_t>& trip) {
+        size_t s = slots_by_key.at(map_key);
+        Slot& slot = slots[s];
+        
+        slot.trips[direction] = trip;
+        
+        uint8_t directions = slot.directions.fetch_or(1 << direction, memory_order_acq_rel) | (1 << direction);
+        if(directions != 3) return;
+        
+        int64_t expected = -1;
+        if(winner.compare_exchange_strong(expected, s, memory_order_acq_rel)) stop_token.request();
+    }
+    
+    KnightMovesResult getResult() {
+        KnightMovesResult r;
+        int64_t s = winner.load(memory_order_acquire);
+        
+        if(s < 0) return r;
+        
+        r.found = true;
+        r.a = slots[s].a;
+        r.b = slots[s].b;
+        r.c = slots[s].c;
+        r.trip_a6f1 = slots[s].trips[TRIP_A6F1_DIRECTION];
+        r.trip_a1f6 = slots[s].trips[TRIP_A1F6_DIRECTION];
+        
+        return r;
+    }
 private:
-    const vector<pair<int8_t, int8_t>> KNIGHT_MOVES = {
-        {2, 1},
-        {1, 2},
-        {-1, 2},
-        {-2, 1},
-        {-2, -1},
-        {-1, -2},
-        {1, -2},
-        {2, -1},
+    struct Slot {
+        int8_t a, b, c;
+        atomic<uint8_t> directions{0};
+        vector<int8_t> trips[2];
     };
     
-    int8_t start_i, start_j, finish_i, finish_j;
-    int8_t trip_length = TRIP_LENGTH_MIN;
-    int8_t move_count = 0;
+    vector<Slot> slots;
+    unordered_map<size_t, size_t> slots_by_key;
     
-    vector<vector<int8_t>> board;
-    vector<pair<int8_t, int8_t>> trip_tracker;
+    atomic<int64_t> winner{-1};
+    StopToken& stop_token;
+};
+
+// ************************************************************************************
+
+template<typename Board>
+void printResult(const KnightMovesResult& result) {
+    cout << "I found it!" << endl;
+    cout << static_cast<int>(result.a) << "," << static_cast<int>(result.b) << "," << static_cast<int>(result.c) << ",";
     
-    // we have this for each instance as we remove candidates from the list once found to avoid unnecessary score calculations for future trips
-    vector<CandidateBoard> candidate_boards;
+    printTrip<Board>(result.trip_a1f6);
+    cout << ",";
+    printTrip<Board>(result.trip_a6f1);
+    cout << endl;
+}
+
+// ************************************************************************************
+
+/*
+ Pass state of one trip direction. The search itself runs in TripsSearch workers over prefix subtrees,
+ which report the trips they find here.
+ */
+struct TripsFinder {
+public:
+    TripsFinder(const int8_t& start_cell, const int8_t& finish_cell, const int8_t& direction, const vector<CandidateBoard>& candidate_boards, ResultsTable& results, const StopToken& stop_token): start_cell(start_cell), finish_cell(finish_cell), direction(direction), results(results), stop_token(stop_token) {
+        this->candidate_boards = candidate_boards;
+    };
     
-    // ************************************************************************************
+    /*
+     Each pass is a single search which checks for the finish cell at every depth of its window of trip lengths.
+     With the corner cells of the puzzle only one length of the window can reach the finish, the other one is the
+     wrong parity, so a pass is the search of one length without a separate pass for the unreachable one.
+     The results of a pass are published shortest first, which keeps the order we had with one search per length.
+     Trips of the shortest length of the window can't be beaten anymore, so these are published right away.
+     */
+    void startPass(const int8_t& length_min, const int8_t& length_max) {
+        trip_length_min = length_min;
+        trip_length_max = length_max;
+        
+        best_lengths.assign(candidate_boards.size(), trip_length_max + 1);
+        best_trips.assign(candidate_boards.size(), vector<int8_t>());
+        published.assign(candidate_boards.size(), false);
+    }
     
-    bool isValidMove(int8_t& i, int8_t& j) {
-        return i >= 0 && i < BOARD_SIZE && j >= 0 && j < BOARD_SIZE && board[i][j] == DEFAULT_CELL_VALUE;
+    void recordTrip(const size_t& k, const vector<int8_t>& trip) {
+        lock_guard<mutex> lock(pass_mutex);
+        int8_t length = trip.size() - 1;
+        
+        if(length >= best_lengths[k]) return;
+        
+        best_lengths[k] = length;
+        best_trips[k] = trip;
+        
+        if(length == trip_length_min && !published[k]) publishTrip(k);
     }
     
-    void tryCandidateBoards() {
-        for(auto it = candidate_boards.begin(); it != candidate_boards.end();) {
-            if(it->isValidTrip(trip_tracker, trip_length)) {
-                lock_guard<mutex> lock(valid_trips_mutex);
-                
-                if(valid_trips.count(it->getMapKey())) {
-                    printResult(it->getA(), it->getB(), it->getC(), valid_trips[it->getMapKey()], trip_tracker);
-                    exit(1);
-                }
-                
-                valid_trips.emplace(it->getMapKey(), trip_tracker);
-                it = candidate_boards.erase(it);
+    void publishTrips() {
+        lock_guard<mutex> lock(pass_mutex);
+        
+        for(int8_t length = trip_length_min; length <= trip_length_max; ++length) {
+            for(size_t k = 0; k < candidate_boards.size(); ++k) {
+                if(best_lengths[k] == length && !published[k]) publishTrip(k);
+            }
+        }
+        
+        vector<CandidateBoard> remaining;
+        
+        for(size_t k = 0; k < candidate_boards.size(); ++k) {
+            if(published[k]) {
+                removed_trips.emplace_back(candidate_boards[k].getMapKey(), best_trips[k]);
             } else {
-                it++;
+                remaining.push_back(candidate_boards[k]);
             }
         }
+        
+        if(remaining.size() != candidate_boards.size()) candidates_version++;
+        candidate_boards = remaining;
     }
     
-    void move(int8_t& i, int8_t& j) {
-        move_count++;
+    // ************************************************************************************
+    
+    // the trips published by the finished passes, by the map key of their candidate board
+    vector<pair<size_t, vector<int8_t>>> getRemovedTrips() {
+        lock_guard<mutex> lock(pass_mutex);
+        return removed_trips;
+    }
+    
+    // the shortest trips the pass found so far
+    vector<pair<size_t, vector<int8_t>>> getPassTrips() {
+        lock_guard<mutex> lock(pass_mutex);
+        vector<pair<size_t, vector<int8_t>>> r;
         
-        if(move_count > trip_length) {
-            if(i == finish_i && j == finish_j) {
-                tryCandidateBoards();
-            }
-            
-            move_count--;
-            return;
+        for(size_t k = 0; k < candidate_boards.size(); ++k) {
+            if(best_lengths[k] <= trip_length_max) r.emplace_back(candidate_boards[k].getMapKey(), best_trips[k]);
         }
         
-        for(auto& [di, dj] : KNIGHT_MOVES) {
-            int8_t next_i = i + di, next_j = j + dj;
+        return r;
+    }
+    
+    // publishes the trips of the finished passes of a checkpoint again, before the first pass
+    void restoreRemovedTrips(const vector<pair<size_t, vector<int8_t>>>& trips) {
+        lock_guard<mutex> lock(pass_mutex);
+        unordered_map<size_t, const vector<int8_t>*> trips_by_key;
+        
+        for(auto& [map_key, trip] : trips) trips_by_key.emplace(map_key, &trip);
+        
+        vector<CandidateBoard> remaining;
+        
+        for(CandidateBoard& candidate : candidate_boards) {
+            auto it = trips_by_key.find(candidate.getMapKey());
             
-            if(isValidMove(next_i, next_j)) {
-                board[next_i][next_j] = move_count;
-                trip_tracker.emplace_back(next_i, next_j);
-                
-                move(next_i, next_j);
-                
-                board[next_i][next_j] = DEFAULT_CELL_VALUE;
-                trip_tracker.pop_back();
+            if(it == trips_by_key.end()) {
+                remaining.push_back(candidate);
+                continue;
             }
+            
+            results.publish(it->first, direction, *it->second);
+            removed_trips.emplace_back(it->first, *it->second);
         }
         
-        move_count--;
-        return;
+        if(remaining.size() != candidate_boards.size()) candidates_version++;
+        candidate_boards = remaining;
+    }
+    
+    // records the trips the pass of a checkpoint had found, after its start
+    void restorePassTrips(const vector<pair<size_t, vector<int8_t>>>& trips) {
+        for(auto& [map_key, trip] : trips) {
+            for(size_t k = 0; k < candidate_boards.size(); ++k) if(candidate_boards[k].getMapKey() == map_key) recordTrip(k, trip);
+        }
+    }
+    
+    // ************************************************************************************
+    
+    bool isDone() {
+        return candidate_boards.empty();
+    }
+    
+    const StopToken& getStopToken() {
+        return stop_token;
+    }
+    
+    int8_t getStartCell() {
+        return start_cell;
+    }
+    
+    int8_t getDirection() {
+        return direction;
+    }
+    
+    int8_t getFinishCell() {
+        return finish_cell;
+    }
+    
+    int8_t getTripLengthMin() {
+        return trip_length_min;
+    }
+    
+    int8_t getTripLengthMax() {
+        return trip_length_max;
+    }
+    
+    vector<CandidateBoard>& getCandidateBoards() {
+        return candidate_boards;
+    }
+    
+    size_t getCandidatesVersion() {
+        return candidates_version;
+    }
+    
+    vector<int8_t> getBestLengths() {
+        lock_guard<mutex> lock(pass_mutex);
+        return best_lengths;
+    }
+private:
+    int8_t start_cell, finish_cell;
+    int8_t trip_length_min, trip_length_max;
+    int8_t direction;
+    
+    ResultsTable& results;
+    const StopToken& stop_token;
+    
+    // we have this for each instance as we remove candidates from the list once found to avoid unnecessary score calculations for future trips
+    vector<CandidateBoard> candidate_boards;
+    size_t candidates_version = 0;
+    
+    // shortest trip found in the current pass for every candidate board, its length is trip_length_max + 1 if none
+    vector<int8_t> best_lengths;
+    vector<vector<int8_t>> best_trips;
+    vector<bool> published;
+    
+    // trips of the candidates removed after their pass, kept for the checkpoints
+    vector<pair<size_t, vector<int8_t>>> removed_trips;
+    
+    mutex pass_mutex;
+    
+    // ************************************************************************************
+    
+    void publishTrip(const size_t& k) {
+        results.publish(candidate_boards[k].getMapKey(), direction, best_trips[k]);
+        published[k] = true;
     }
 };
 
 // ************************************************************************************
 
-vector<CandidateBoard> generateCandidateBoards() {
-    vector<CandidateBoard> r;
-    do {
-        r.emplace_back(TARGET_ABC[0], TARGET_ABC[1], TARGET_ABC[2]);
-    } while (std::next_permutation(TARGET_ABC.begin(), TARGET_ABC.end()));
-    
-    return r;
+// step kernels of CandidateBatch, the SIMD ones are compiled for their instruction set and picked at runtime
+enum class ScoreKernel {
+    SCALAR,
+    AVX2,
+    AVX512,
+};
+
+const char* getKernelName(const ScoreKernel& kernel) {
+    switch(kernel) {
+        case ScoreKernel::AVX2: return "AVX2";
+        case ScoreKernel::AVX512: return "AVX-512";
+        default: return "scalar";
+    }
 }
 
-// ************************************************************************************
+bool isKernelSupported(const ScoreKernel& kernel) {
+#if defined(__x86_64__)
+    switch(kernel) {
+        case ScoreKernel::AVX2: return __builtin_cpu_supports("avx2");
+        case ScoreKernel::AVX512: return __builtin_cpu_supports("avx512f");
+        default: return true;
+    }
+#else
+    return kernel == ScoreKernel::SCALAR;
+#endif
+}
 
-int main(int argc, const char * argv[]) {
-    
-    vector<CandidateBoard> candidate_boards = generateCandidateBoards();
-    
-    TripsFinder tripFinder1 = TripsFinder(TRIP_A6F1_START, TRIP_A6F1_FINISH, candidate_boards);
-    TripsFinder tripFinder2 = TripsFinder(TRIP_A1F6_START, TRIP_A1F6_FINISH, candidate_boards);
-    
-    thread t1([&tripFinder1]() { tripFinder1.run(); });
-    thread t2([&tripFinder2]() { tripFinder2.run(); });
-    
-    t1.join();
-    t2.join();
+// the widest kernel of the CPU
+ScoreKernel getBestKernel() {
+    static const ScoreKernel best_kernel = isKernelSupported(ScoreKernel::AVX512) ? ScoreKernel::AVX512 : isKernelSupported(ScoreKernel::AVX2) ? ScoreKernel::AVX2 : ScoreKernel::SCALAR;
+    return best_kernel;
+}
 
-    cout << "Trips not found :(" << endl;
-    return 0;
+/*
+ Structure of arrays copy of the candidate boards for scoring one step of a trip against all of them at once,
+ values[region][k] is the value candidate k gives to the region. All candidates apply the same operation for a step,
+ as it only depends on the regions, so a step is one add or one multiply per SIMD lane. Scores are kept as 32 bits and
+ saturated at TARGET_SCORE + 1 like in CandidateBoard, or at another limit for sweeps over many targets. The batch is
+ padded to full vectors with lanes which start at the limit and step by a value of 1, so they stay at the limit without
+ overflowing whatever the limit is.
+ */
+struct CandidateBatch {
+public:
+    void assign(const vector<CandidateBoard>& candidate_boards, const uint32_t& limit = SCORE_LIMIT) {
+        size = candidate_boards.size();
+        stride = (size + SCORE_LANES - 1) / SCORE_LANES * SCORE_LANES;
+        this->limit = limit;
+        
+        for(vector<uint32_t>& region_values : values) region_values.assign(stride, 1);
+        
+        for(size_t k = 0; k < size; ++k) {
+            CandidateBoard candidate = candidate_boards[k];
+            values[0][k] = candidate.getA();
+            values[1][k] = candidate.getB();
+            values[2][k] = candidate.getC();
+        }
+    }
+    
+    size_t getStride() {
+        return stride;
+    }
+    
+    const uint32_t* getValues(const int8_t& region) {
+        return values[region].data();
+    }
+    
+    // the kernel must be supported by the CPU, the widest one is used by default
+    void setKernel(const ScoreKernel& kernel) {
+        this->kernel = kernel;
+    }
+    
+    // scores of the one cell trip, returns false if every candidate is above the target
+    bool startScores(const int8_t& region, uint32_t* scores) {
+        bool reachable = false;
+        
+        for(size_t k = 0; k < stride; ++k) {
+            scores[k] = k < size ? min(values[region][k], limit) : limit;
+            reachable |= scores[k] < limit;
+        }
+        
+        return reachable;
+    }
+    
+    // scores after a move from prev_region to next_region, returns false if every candidate is above the target
+    bool stepScores(const uint32_t* prev_scores, const int8_t& prev_region, const int8_t& next_region, uint32_t* next_scores) {
+#if defined(__x86_64__)
+        if(kernel == ScoreKernel::AVX512) return stepScoresAVX512(prev_scores, prev_region == next_region, values[next_region].data(), next_scores);
+        if(kernel == ScoreKernel::AVX2) return stepScoresAVX2(prev_scores, prev_region == next_region, values[next_region].data(), next_scores);
+#endif
+        return stepScoresScalar(prev_scores, prev_region == next_region, values[next_region].data(), next_scores);
+    }
+    
+    bool stepScoresScalar(const uint32_t* prev_scores, const bool& add, const uint32_t* next_values, uint32_t* next_scores) {
+        bool reachable = false;
+        
+        for(size_t k = 0; k < stride; ++k) {
+            uint32_t score = add ? prev_scores[k] + next_values[k] : prev_scores[k] * next_values[k];
+            
+            next_scores[k] = min(score, limit);
+            reachable |= next_scores[k] < limit;
+        }
+        
+        return reachable;
+    }
+    
+#if defined(__x86_64__)
+    __attribute__((target("avx2"))) bool stepScoresAVX2(const uint32_t* prev_scores, const bool& add, const uint32_t* next_values, uint32_t* next_scores) {
+        const __m256i limit = _mm256_set1_epi32(this->limit);
+        int reachable = 0;
+        
+        for(size_t k = 0; k < stride; k += 8) {
+            __m256i score = _mm256_loadu_si256((const __m256i*)(prev_scores + k));
+            
+            // lanes only grow, so a block which is all above the target stays that way
+            int alive = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(limit, score)));
+            
+            if(alive) {
+                __m256i value = _mm256_loadu_si256((const __m256i*)(next_values + k));
+                score = _mm256_min_epu32(add ? _mm256_add_epi32(score, value) : _mm256_mullo_epi32(score, value), limit);
+                reachable |= _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(limit, score)));
+            }
+            
+            _mm256_storeu_si256((__m256i*)(next_scores + k), score);
+        }
+        
+        return reachable != 0;
+    }
+    
+    __attribute__((target("avx512f"))) bool stepScoresAVX512(const uint32_t* prev_scores, const bool& add, const uint32_t* next_values, uint32_t* next_scores) {
+        const __m512i limit = _mm512_set1_epi32(this->limit);
+        __mmask16 reachable = 0;
+        
+        for(size_t k = 0; k < stride; k += 16) {
+            __m512i score = _mm512_loadu_si512(prev_scores + k);
+            
+            // only the lanes still below the target are updated, the others are already saturated
+            __mmask16 alive = _mm512_cmplt_epu32_mask(score, limit);
+            
+            if(alive) {
+                __m512i value = _mm512_loadu_si512(next_values + k);
+                __m512i next = add ? _mm512_add_epi32(score, value) : _mm512_mullo_epi32(score, value);
+                score = _mm512_mask_min_epu32(score, alive, next, limit);
+                reachable |= _mm512_cmplt_epu32_mask(score, limit);
+            }
+            
+            _mm512_storeu_si512(next_scores + k, score);
+        }
+        
+        return reachable != 0;
+    }
+#endif
+private:
+    size_t size = 0, stride = 0;
+    uint32_t limit = SCORE_LIMIT;
+    vector<uint32_t> values[3];
+    
+    ScoreKernel kernel = getBestKernel();
+};
+
+/*
+ Compares every SIMD step the CPU supports against the scalar one on random scores of a wide candidate sweep, run with
+ --check-kernels. The kernels which were compared are added to tested_kernels.
+ */
+bool checkScoreKernels(const vector<CandidateBoard>& candidate_boards, vector<ScoreKernel>& tested_kernels) {
+    CandidateBatch batch;
+    batch.assign(candidate_boards);
+    
+    size_t stride = batch.getStride();
+    vector<uint32_t> prev_scores(stride), simd_scores(stride), scalar_scores(stride);
+    
+    for(ScoreKernel kernel : {ScoreKernel::AVX2, ScoreKernel::AVX512}) {
+        if(!isKernelSupported(kernel)) continue;
+        
+        batch.setKernel(kernel);
+        tested_kernels.push_back(kernel);
+        mt19937 random(2024);
+        
+        for(int test = 0; test < 10'000; ++test) {
+            for(uint32_t& score : prev_scores) score = random() % (SCORE_LIMIT + 1);
+            
+            int8_t prev_region = random() % 3, next_region = random() % 3;
+            bool add = prev_region == next_region;
+            
+            bool simd_reachable = batch.stepScores(prev_scores.data(), prev_region, next_region, simd_scores.data());
+            bool scalar_reachable = batch.stepScoresScalar(prev_scores.data(), add, batch.getValues(next_region), scalar_scores.data());
+            
+            if(simd_reachable != scalar_reachable || simd_scores != scalar_scores) return false;
+        }
+    }
+    
+    return true;
+}
+
+// ************************************************************************************
+
+/*
+ A trip's score only depends on the regions of its cells, so the candidate scores are kept per region signature instead
+ of per trip: the signature is the sequence of regions as a base 3 number after a leading 1, which fits the 64 bits up to
+ SIGNATURE_LENGTH_MAX moves. Every distinct signature prefix is scored once against all the candidate boards and shared by all
+ the trips walking through it, a trip ending on the finish is checked once per signature as well.
+ */
+template<typename Board>
+struct SignatureScores {
+public:
+    // the cached rows are only valid for the candidate boards of one TripsFinder, as they were when the rows were computed
+    void bind(TripsFinder& finder) {
+        if(this->finder == &finder && candidates_version == finder.getCandidatesVersion()) return;
+        
+        this->finder = &finder;
+        candidate_boards = &finder.getCandidateBoards();
+        candidates_version = finder.getCandidatesVersion();
+        
+        batch.assign(*candidate_boards);
+        stride = batch.getStride();
+        
+        rows.clear();
+        scores.assign((Board::TRIP_LENGTH_MAX + 1) * stride, 0);
+        reachable.assign(Board::TRIP_LENGTH_MAX + 1, false);
+        checked.assign(Board::TRIP_LENGTH_MAX + 1, false);
+    }
+    
+    // the row of the one cell trip, the rows up to TRIP_LENGTH_MAX are scratch rows, one per depth
+    size_t startRow(const uint64_t& signature, const int8_t& cell) {
+        return row(signature, cell, cell, 0, 0);
+    }
+    
+    // the row of the prefix extended by a move from cell to next_cell, parent_row being the row of the prefix
+    size_t stepRow(const uint64_t& signature, const size_t& parent_row, const int8_t& cell, const int8_t& next_cell, const int8_t& move_count) {
+        return row(signature, cell, next_cell, parent_row, move_count);
+    }
+    
+    const uint32_t* getScores(const size_t& row) {
+        return &scores[row * stride];
+    }
+    
+    bool isReachable(const size_t& row) {
+        return reachable[row];
+    }
+    
+    // true only for the first trip ending with this signature, as all the others would score the same
+    bool check(const size_t& row) {
+        if(row <= size_t(Board::TRIP_LENGTH_MAX)) return true;
+        if(checked[row]) return false;
+        
+        checked[row] = true;
+        return true;
+    }
+private:
+    TripsFinder* finder = nullptr;
+    vector<CandidateBoard>* candidate_boards;
+    size_t candidates_version;
+    
+    CandidateBatch batch;
+    size_t stride;
+    
+    unordered_map<uint64_t, size_t> rows;
+    vector<uint32_t> scores;
+    vector<bool> reachable, checked;
+    
+    size_t row(const uint64_t& signature, const int8_t& cell, const int8_t& next_cell, const size_t& parent_row, const int8_t& move_count) {
+        size_t n = stride;
+        
+        auto it = rows.find(signature);
+        if(it != rows.end()) return it->second;
+        
+        // when the cache is full new signatures are still scored, just not kept
+        size_t r = move_count;
+        
+        if(scores.size() + n <= SIGNATURE_SCORES_MAX) {
+            r = reachable.size();
+            rows.emplace(signature, r);
+            
+            scores.resize(scores.size() + n);
+            reachable.push_back(false);
+            checked.push_back(false);
+        }
+        
+        if(move_count == 0) {
+            reachable[r] = batch.startScores(Board::CELL_REGIONS[next_cell], &scores[r * n]);
+        } else {
+            reachable[r] = batch.stepScores(&scores[parent_row * n], Board::CELL_REGIONS[cell], Board::CELL_REGIONS[next_cell], &scores[r * n]);
+        }
+        
+        checked[r] = false;
+        return r;
+    }
+};
+
+// ************************************************************************************
+
+// search state of a single worker, it walks one prefix subtree of a TripsFinder pass at a time
+template<typename Board>
+struct TripsSearch {
+public:
+    // all trip prefixes of split_depth moves which can still score the target, each of them is searched separately
+    vector<vector<int8_t>> split(TripsFinder& finder, const int8_t& split_depth) {
+        prefixes.clear();
+        this->split_depth = split_depth;
+        
+        search(finder, {finder.getStartCell()});
+        
+        this->split_depth = -1;
+        return prefixes;
+    }
+    
+    void search(TripsFinder& finder, const vector<int8_t>& prefix) {
+        this->finder = &finder;
+        candidate_boards = &finder.getCandidateBoards();
+        stop_token = &finder.getStopToken();
+        finish_cell = finder.getFinishCell();
+        trip_length_min = finder.getTripLengthMin();
+        trip_length_max = finder.getTripLengthMax();
+        
+        // trips other workers already found only cut the lengths which can't be the shortest anymore
+        best_lengths = finder.getBestLengths();
+        
+        // every direction keeps its own cache, as a worker switches between them from task to task
+        signature_scores = &finder_signature_scores[&finder];
+        signature_scores->bind(finder);
+        
+        signatures.resize(Board::TRIP_LENGTH_MAX + 1);
+        rows.resize(Board::TRIP_LENGTH_MAX + 1);
+        
+        signatures[0] = 3 + Board::CELL_REGIONS[prefix[0]];
+        rows[0] = signature_scores->startRow(signatures[0], prefix[0]);
+        
+        for(size_t i = 1; i < prefix.size(); ++i) {
+            signatures[i] = signatures[i - 1] * 3 + Board::CELL_REGIONS[prefix[i]];
+            rows[i] = signature_scores->stepRow(signatures[i], rows[i - 1], prefix[i - 1], prefix[i], i);
+        }
+        
+        visited = 0;
+        for(const int8_t& cell : prefix) visited |= Bitboard(1) << cell;
+        
+        trip_tracker = prefix;
+        trip_tracker.reserve(trip_length_max + 1);
+        
+        move_count = prefix.size() - 1;
+        move(prefix.back());
+    }
+    
+    size_t getNodesCount() {
+        return counters.nodes.get();
+    }
+    
+    const SearchCounters& getCounters() {
+        return counters;
+    }
+private:
+    TripsFinder* finder;
+    vector<CandidateBoard>* candidate_boards;
+    const StopToken* stop_token;
+    
+    int8_t finish_cell;
+    int8_t trip_length_min, trip_length_max;
+    int8_t split_depth = -1;
+    int8_t move_count = 0;
+    SearchCounters counters;
+    
+    Bitboard visited;
+    vector<int8_t> trip_tracker;
+    vector<vector<int8_t>> prefixes;
+    
+    // region signature of the trip prefix after n moves and its row of candidate scores
+    unordered_map<TripsFinder*, SignatureScores<Board>> finder_signature_scores;
+    SignatureScores<Board>* signature_scores;
+    vector<uint64_t> signatures;
+    vector<size_t> rows;
+    vector<int8_t> best_lengths;
+    
+    // ************************************************************************************
+    
+    void recordTrip() {
+        if(!signature_scores->check(rows[move_count])) return;
+        
+        const uint32_t* trip_scores = signature_scores->getScores(rows[move_count]);
+        
+        for(size_t k = 0; k < candidate_boards->size(); ++k) {
+            if(trip_scores[k] == TARGET_SCORE && move_count < best_lengths[k]) {
+                best_lengths[k] = move_count;
+                finder->recordTrip(k, trip_tracker);
+            }
+        }
+    }
+    
+    // looks up the scores after the move to next_cell and returns false if no candidate board can still reach the target
+    bool updateScores(const int8_t& cell, const int8_t& next_cell) {
+        signatures[move_count] = signatures[move_count - 1] * 3 + Board::CELL_REGIONS[next_cell];
+        rows[move_count] = signature_scores->stepRow(signatures[move_count], rows[move_count - 1], cell, next_cell, move_count);
+        
+        return signature_scores->isReachable(rows[move_count]);
+    }
+    
+    // move_count is the number of moves the trip made to get to the cell
+    void move(int8_t cell) {
+        if(stop_token->isRequested()) return;
+        
+        counters.nodes.add();
+        
+        // the finish cell can't be visited twice, so the trip ends here whatever its length is
+        if(cell == finish_cell) {
+            counters.leaves.add();
+            if(move_count >= trip_length_min) recordTrip();
+            return;
+        }
+        
+        if(move_count == split_depth) {
+            prefixes.push_back(trip_tracker);
+            return;
+        }
+        
+        if(move_count == trip_length_max) {
+            counters.length_prunes.add();
+            return;
+        }
+        
+        Bitboard next_moves = Board::KNIGHT_ATTACKS[cell] & ~visited;
+        
+        // all the cells next to the finish are visited, so only a move straight onto it can still end the trip
+        if(!(Board::KNIGHT_ATTACKS[finish_cell] & ~visited)) next_moves &= Bitboard(1) << finish_cell;
+        
+        move_count++;
+        
+        // walk over the set bits of all unvisited knight destinations, lowest cell first
+        for(Bitboard moves = next_moves; moves; moves &= moves - 1) {
+            int8_t next_cell = __builtin_ctzll(moves);
+            
+            // the finish cell is too far or on the wrong color for every remaining trip length
+            if(!Board::canReach(finish_cell, next_cell, move_count, trip_length_min, trip_length_max)) {
+                counters.reach_prunes.add();
+                continue;
+            }
+            
+            // every candidate board is already above the target score for this prefix
+            if(!updateScores(cell, next_cell)) {
+                counters.score_prunes.add();
+                continue;
+            }
+            
+            visited ^= Bitboard(1) << next_cell;
+            trip_tracker.push_back(next_cell);
+            
+            move(next_cell);
+            
+            visited ^= Bitboard(1) << next_cell;
+            trip_tracker.pop_back();
+        }
+        
+        move_count--;
+        return;
+    }
+};
+
+// ************************************************************************************
+
+/*
+ Meet-in-the-middle search for trips of one exact length. The first half of the trip is enumerated forward from the start
+ and indexed by its last cell and score, the second half is enumerated backward from the finish. A second half is a chain of
+ add / multiply steps, so it is an affine function score * factor + term of the score it continues from, and the first half
+ it needs is looked up directly. The two halves join when they share only the meeting cell.
+ */
+template<typename Board>
+struct BidirectionalSearch {
+public:
+    void search(TripsFinder& finder, const int8_t& trip_length) {
+        this->finder = &finder;
+        candidate_boards = &finder.getCandidateBoards();
+        stop_token = &finder.getStopToken();
+        start_cell = finder.getStartCell();
+        finish_cell = finder.getFinishCell();
+        
+        size_t n = candidate_boards->size();
+        if(n == 0) return;
+        
+        forward_length = trip_length / 2;
+        backward_length = trip_length - forward_length;
+        found.assign(n, false);
+        
+        // ************************************************************************************
+        
+        forward_visited.clear();
+        forward_cells.clear();
+        forward_index.clear();
+        
+        scores.resize((forward_length + 1) * n);
+        for(size_t k = 0; k < n; ++k) scores[k] = (*candidate_boards)[k].startScore(Board::CELL_REGIONS[start_cell]);
+        
+        trip_tracker = {start_cell};
+        visited = Bitboard(1) << start_cell;
+        move_count = 0;
+        moveForward(start_cell);
+        
+        // ************************************************************************************
+        
+        factors.resize((backward_length + 1) * n);
+        terms.resize((backward_length + 1) * n);
+        for(size_t k = 0; k < n; ++k) {
+            factors[k] = 1;
+            terms[k] = 0;
+        }
+        
+        trip_tracker = {finish_cell};
+        visited = Bitboard(1) << finish_cell;
+        move_count = 0;
+        moveBackward(finish_cell);
+    }
+private:
+    TripsFinder* finder;
+    vector<CandidateBoard>* candidate_boards;
+    const StopToken* stop_token;
+    
+    int8_t start_cell, finish_cell;
+    int8_t forward_length, backward_length;
+    int8_t move_count;
+    
+    Bitboard visited;
+    vector<int8_t> trip_tracker;
+    
+    // only the first trip of every candidate board is needed
+    vector<bool> found;
+    
+    // forward score rows of the first half, and factor / term rows of the second half, one entry per candidate board
+    vector<size_t> scores, factors, terms;
+    
+    // all first halves, forward_length + 1 cells each, and their positions by meeting cell, candidate board and score
+    vector<Bitboard> forward_visited;
+    vector<int8_t> forward_cells;
+    unordered_map<size_t, vector<uint32_t>> forward_index;
+    
+    // ************************************************************************************
+    
+    size_t indexKey(const int8_t& cell, const size_t& k, const size_t& score) {
+        return (cell * candidate_boards->size() + k) * (TARGET_SCORE + 1) + score;
+    }
+    
+    void moveForward(int8_t cell) {
+        size_t n = candidate_boards->size();
+        
+        if(stop_token->isRequested()) return;
+        
+        if(move_count == forward_length) {
+            uint32_t position = forward_visited.size();
+            
+            forward_visited.push_back(visited);
+            forward_cells.insert(forward_cells.end(), trip_tracker.begin(), trip_tracker.end());
+            
+            for(size_t k = 0; k < n; ++k) {
+                size_t score = scores[move_count * n + k];
+                if(score <= TARGET_SCORE) forward_index[indexKey(cell, k, score)].push_back(position);
+            }
+            
+            return;
+        }
+        
+        // the finish cell can only be the last cell of the trip
+        Bitboard next_moves = Board::KNIGHT_ATTACKS[cell] & ~visited & ~(Bitboard(1) << finish_cell);
+        int8_t trip_length = forward_length + backward_length;
+        
+        move_count++;
+        
+        for(Bitboard moves = next_moves; moves; moves &= moves - 1) {
+            int8_t next_cell = __builtin_ctzll(moves);
+            bool reachable = false;
+            
+            if(!Board::canReach(finish_cell, next_cell, move_count, trip_length, trip_length)) continue;
+            
+            // the second half can only increase the score
+            for(size_t k = 0; k < n; ++k) {
+                scores[move_count * n + k] = (*candidate_boards)[k].stepScore(scores[(move_count - 1) * n + k], Board::CELL_REGIONS[cell], Board::CELL_REGIONS[next_cell]);
+                reachable |= scores[move_count * n + k] <= TARGET_SCORE;
+            }
+            
+            if(!reachable) continue;
+            
+            visited ^= Bitboard(1) << next_cell;
+            trip_tracker.push_back(next_cell);
+            
+            moveForward(next_cell);
+            
+            visited ^= Bitboard(1) << next_cell;
+            trip_tracker.pop_back();
+        }
+        
+        move_count--;
+    }
+    
+    void joinHalves(const int8_t& cell) {
+        size_t n = candidate_boards->size();
+        
+        for(size_t k = 0; k < n; ++k) {
+            size_t factor = factors[move_count * n + k], term = terms[move_count * n + k];
+            
+            if(found[k] || factor + term > TARGET_SCORE || (TARGET_SCORE - term) % factor != 0) continue;
+            
+            auto it = forward_index.find(indexKey(cell, k, (TARGET_SCORE - term) / factor));
+            if(it == forward_index.end()) continue;
+            
+            for(const uint32_t& position : it->second) {
+                // the halves may only share the meeting cell
+                if((forward_visited[position] & visited) != Bitboard(1) << cell) continue;
+                
+                vector<int8_t> trip(forward_cells.begin() + position * (forward_length + 1), forward_cells.begin() + (position + 1) * (forward_length + 1));
+                trip.insert(trip.end(), trip_tracker.rbegin() + 1, trip_tracker.rend());
+                
+                finder->recordTrip(k, trip);
+                found[k] = true;
+                break;
+            }
+        }
+    }
+    
+    // trip_tracker holds the second half in reverse, from the finish cell back to the cell
+    void moveBackward(int8_t cell) {
+        size_t n = candidate_boards->size();
+        
+        if(stop_token->isRequested()) return;
+        
+        if(move_count == backward_length) {
+            joinHalves(cell);
+            return;
+        }
+        
+        Bitboard next_moves = Board::KNIGHT_ATTACKS[cell] & ~visited & ~(Bitboard(1) << start_cell);
+        int8_t trip_length = forward_length + backward_length;
+        
+        move_count++;
+        
+        for(Bitboard moves = next_moves; moves; moves &= moves - 1) {
+            int8_t prev_cell = __builtin_ctzll(moves);
+            bool reachable = false;
+            
+            if(!Board::canReach(start_cell, prev_cell, move_count, trip_length, trip_length)) continue;
+            
+            /*
+             The trip now continues from prev_cell to cell first, so the suffix function becomes f(step(score)).
+             Any score before it is at least 1, so once factor + term is above the target it stays there.
+             */
+            for(size_t k = 0; k < n; ++k) {
+                if(found[k]) continue;
+                
+                pair<size_t, size_t> step = (*candidate_boards)[k].stepFunction(Board::CELL_REGIONS[prev_cell], Board::CELL_REGIONS[cell]);
+                size_t factor = factors[(move_count - 1) * n + k], term = terms[(move_count - 1) * n + k];
+                
+                factors[move_count * n + k] = min(factor * step.first, TARGET_SCORE + 1);
+                terms[move_count * n + k] = min(factor * step.second + term, TARGET_SCORE + 1);
+                reachable |= factors[move_count * n + k] + terms[move_count * n + k] <= TARGET_SCORE;
+            }
+            
+            if(!reachable) continue;
+            
+            visited ^= Bitboard(1) << prev_cell;
+            trip_tracker.push_back(prev_cell);
+            
+            moveBackward(prev_cell);
+            
+            visited ^= Bitboard(1) << prev_cell;
+            trip_tracker.pop_back();
+        }
+        
+        move_count--;
+    }
+};
+
+// ************************************************************************************
+
+/*
+ Shortest trip of one direction for every candidate board and every score up to score_max, so any target in that range
+ is answered by a lookup. Trips of the same length are kept in lexicographic order, which makes the index the same
+ whichever worker found them. The trips are appended to a pool, each as its number of moves followed by its cells.
+ Only a few percent of the candidate and score pairs are ever reached, so the positions are kept by pair instead of
+ in a table over all of them.
+ */
+struct ScoreIndex {
+public:
+    void assign(const size_t& score_max) {
+        scores_count = score_max + 1;
+        positions.clear();
+        trips.clear();
+    }
+    
+    // position is the trip in the pool, -1 until one of its scores keeps it, so a trip is stored once for all the candidates
+    void record(const size_t& k, const size_t& score, const vector<int8_t>& trip, int64_t& position) {
+        auto [it, inserted] = positions.try_emplace(k * scores_count + score, -1);
+        if(!inserted && !isBetter(trip, it->second)) return;
+        
+        if(position < 0) position = addTrip(trip);
+        it->second = position;
+    }
+    
+    void merge(const ScoreIndex& other) {
+        
+        // positions of the other pool already copied to this one, a trip kept for many pairs is copied once as well
+        unordered_map<int64_t, int64_t> copied_positions;
+        
+        for(auto& [key, other_position] : other.positions) {
+            vector<int8_t> trip = other.getTrip(other_position);
+            
+            auto it = positions.find(key);
+            if(it != positions.end() && !isBetter(trip, it->second)) continue;
+            
+            auto [copied, inserted] = copied_positions.try_emplace(other_position, -1);
+            if(inserted) copied->second = addTrip(trip);
+            
+            positions[key] = copied->second;
+        }
+    }
+    
+    bool hasTrip(const size_t& k, const size_t& score) const {
+        return positions.count(k * scores_count + score) > 0;
+    }
+    
+    vector<int8_t> getTrip(const size_t& k, const size_t& score) const {
+        return getTrip(positions.at(k * scores_count + score));
+    }
+private:
+    size_t scores_count = 0;
+    unordered_map<size_t, int64_t> positions;
+    vector<int8_t> trips;
+    
+    int64_t addTrip(const vector<int8_t>& trip) {
+        int64_t position = trips.size();
+        
+        trips.push_back(trip.size() - 1);
+        trips.insert(trips.end(), trip.begin(), trip.end());
+        
+        return position;
+    }
+    
+    vector<int8_t> getTrip(const int64_t& position) const {
+        return vector<int8_t>(trips.begin() + position + 1, trips.begin() + position + 2 + trips[position]);
+    }
+    
+    bool isBetter(const vector<int8_t>& trip, const int64_t& position) const {
+        int8_t length = trip.size() - 1;
+        if(length != trips[position]) return length < trips[position];
+        
+        return lexicographical_compare(trip.begin(), trip.end(), trips.begin() + position + 1, trips.begin() + position + 2 + length);
+    }
+};
+
+/*
+ Search state of a single worker of a score sweep. It walks every trip up to length_max once, the same way TripsSearch does
+ but without a target, and indexes each of them under the score it has on every candidate board that keeps it in range.
+ */
+template<typename Board>
+struct ScoreSweep {
+public:
+    ScoreSweep(CandidateBatch& batch, const size_t& candidates_count, const size_t& score_max, const int8_t& length_max): batch(&batch), candidates_count(candidates_count), score_max(score_max), length_max(length_max) {
+        for(ScoreIndex& index : indexes) index.assign(score_max);
+        scores.resize((length_max + 1) * batch.getStride());
+    }
+    
+    // all trip prefixes of split_depth moves, the trips shorter than that are indexed on the way
+    vector<vector<int8_t>> split(const int8_t& direction, const int8_t& start_cell, const int8_t& finish_cell, const int8_t& split_depth) {
+        prefixes.clear();
+        this->split_depth = split_depth;
+        
+        search(direction, finish_cell, {start_cell});
+        
+        this->split_depth = -1;
+        return prefixes;
+    }
+    
+    void search(const int8_t& direction, const int8_t& finish_cell, const vector<int8_t>& prefix) {
+        size_t stride = batch->getStride();
+        
+        index = &indexes[direction];
+        this->finish_cell = finish_cell;
+        
+        bool reachable = batch->startScores(Board::CELL_REGIONS[prefix[0]], &scores[0]);
+        
+        for(size_t i = 1; i < prefix.size(); ++i) {
+            reachable &= batch->stepScores(&scores[(i - 1) * stride], Board::CELL_REGIONS[prefix[i - 1]], Board::CELL_REGIONS[prefix[i]], &scores[i * stride]);
+        }
+        
+        if(!reachable) return;
+        
+        visited = 0;
+        for(const int8_t& cell : prefix) visited |= Bitboard(1) << cell;
+        
+        trip_tracker = prefix;
+        trip_tracker.reserve(length_max + 1);
+        
+        move_count = prefix.size() - 1;
+        move(prefix.back());
+    }
+    
+    ScoreIndex& getIndex(const int8_t& direction) {
+        return indexes[direction];
+    }
+private:
+    CandidateBatch* batch;
+    size_t candidates_count, score_max;
+    int8_t length_max;
+    
+    int8_t finish_cell;
+    int8_t split_depth = -1;
+    int8_t move_count = 0;
+    
+    Bitboard visited;
+    vector<int8_t> trip_tracker;
+    vector<vector<int8_t>> prefixes;
+    
+    // candidate scores of the trip after n moves, one row of the batch stride per move
+    vector<uint32_t> scores;
+    
+    ScoreIndex indexes[2];
+    ScoreIndex* index;
+    
+    // ************************************************************************************
+    
+    void recordTrip() {
+        const uint32_t* trip_scores = &scores[move_count * batch->getStride()];
+        int64_t position = -1;
+        
+        for(size_t k = 0; k < candidates_count; ++k) {
+            if(trip_scores[k] <= score_max) index->record(k, trip_scores[k], trip_tracker, position);
+        }
+    }
+    
+    void move(int8_t cell) {
+        size_t stride = batch->getStride();
+        
+        if(cell == finish_cell) {
+            recordTrip();
+            return;
+        }
+        
+        if(move_count == split_depth) {
+            prefixes.push_back(trip_tracker);
+            return;
+        }
+        
+        if(move_count == length_max) return;
+        
+        Bitboard next_moves = Board::KNIGHT_ATTACKS[cell] & ~visited;
+        
+        // all the cells next to the finish are visited, so only a move straight onto it can still end the trip
+        if(!(Board::KNIGHT_ATTACKS[finish_cell] & ~visited)) next_moves &= Bitboard(1) << finish_cell;
+        
+        move_count++;
+        
+        for(Bitboard moves = next_moves; moves; moves &= moves - 1) {
+            int8_t next_cell = __builtin_ctzll(moves);
+            
+            if(!Board::canReach(finish_cell, next_cell, move_count, 0, length_max)) continue;
+            
+            // every candidate board is already above the highest target for this prefix
+            if(!batch->stepScores(&scores[(move_count - 1) * stride], Board::CELL_REGIONS[cell], Board::CELL_REGIONS[next_cell], &scores[move_count * stride])) continue;
+            
+            visited ^= Bitboard(1) << next_cell;
+            trip_tracker.push_back(next_cell);
+            
+            move(next_cell);
+            
+            visited ^= Bitboard(1) << next_cell;
+            trip_tracker.pop_back();
+        }
+        
+        move_count--;
+    }
+};
+
+// ************************************************************************************
+
+struct WorkerQueue {
+    mutex mtx;
+    deque<size_t> tasks;
+};
+
+/*
+ Runs the tasks 0..tasks_count-1 on workers_count threads. The tasks are dealt round-robin, every worker takes
+ its own tasks from the front of its queue, so they run roughly in the search order, and once it is empty steals
+ from the back of the other queues. No new tasks are added while running, so a worker is done when all the queues are empty.
+ */
+void runWorkStealing(const size_t& tasks_count, const size_t& workers_count, const function<void(size_t, size_t)>& runTask) {
+    vector<WorkerQueue> queues(workers_count);
+    for(size_t t = 0; t < tasks_count; ++t) queues[t % workers_count].tasks.push_back(t);
+    
+    auto takeTask = [&queues, &workers_count](const size_t& worker, size_t& task) {
+        for(size_t i = 0; i < workers_count; ++i) {
+            WorkerQueue& queue = queues[(worker + i) % workers_count];
+            lock_guard<mutex> lock(queue.mtx);
+            
+            if(queue.tasks.empty()) continue;
+            
+            if(i == 0) {
+                task = queue.tasks.front();
+                queue.tasks.pop_front();
+            } else {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+            }
+            
+            return true;
+        }
+        
+        return false;
+    };
+    
+    vector<thread> workers;
+    for(size_t w = 0; w < workers_count; ++w) {
+        workers.emplace_back([&takeTask, &runTask, w]() {
+            size_t task;
+            while(takeTask(w, task)) runTask(w, task);
+        });
+    }
+    
+    for(thread& worker : workers) worker.join();
+}
+
+// ************************************************************************************
+
+/*
+ The file is written by write and synced next to its final path, then renamed over it, so a killed run keeps the last
+ complete file, be it a checkpoint or a trips store.
+ */
+bool writeFileAtomically(const string& path, const function<bool(FILE*)>& write) {
+    string temp_path = path + ".tmp";
+    FILE* file = fopen(temp_path.c_str(), "wb");
+    if(!file) return false;
+    
+    bool written = write(file);
+    written &= fflush(file) == 0 && fsync(fileno(file)) == 0;
+    written &= fclose(file) == 0;
+    
+    return written && rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+bool writeFileAtomically(const string& path, const string& content) {
+    return writeFileAtomically(path, [&content](FILE* file) {
+        return fwrite(content.data(), 1, content.size(), file) == content.size();
+    });
+}
+
+// ************************************************************************************
+
+/*
+ Binary store of every trip between the corners up to some length, so only the scoring has to run again when
+ TARGET_SCORE or the candidate values change. The file is a header, one index entry per (start, finish, length),
+ then the trips of every entry back to back, each packed as 6 bit cell indexes in (length + 1) * 6 bits rounded up to bytes.
+ */
+const uint32_t TRIPS_STORE_MAGIC = 0x54364D4B; // "KM6T"
+const uint32_t TRIPS_STORE_VERSION = 1;
+
+struct TripsStoreHeader {
+    uint32_t magic, version;
+    uint32_t board_cells, entries_count;
+};
+
+struct TripsStoreEntry {
+    uint8_t start_cell, finish_cell, length, padding[5];
+    uint64_t count, offset;
+};
+
+size_t packedTripSize(const int8_t& length) {
+    return ((length + 1) * 6 + 7) / 8;
+}
+
+void packTrip(const vector<int8_t>& trip, uint8_t* packed) {
+    fill(packed, packed + packedTripSize(trip.size() - 1), 0);
+    
+    for(size_t i = 0; i < trip.size(); ++i) {
+        size_t bit = i * 6;
+        uint16_t cell = uint16_t(trip[i]) << (bit % 8);
+        
+        packed[bit / 8] |= cell & 0xFF;
+        if(cell >> 8) packed[bit / 8 + 1] |= cell >> 8;
+    }
+}
+
+void unpackTrip(const uint8_t* packed, const int8_t& length, vector<int8_t>& trip) {
+    trip.resize(length + 1);
+    
+    for(int8_t i = 0; i <= length; ++i) {
+        size_t bit = i * 6;
+        uint16_t bytes = packed[bit / 8] | (bit % 8 > 2 ? uint16_t(packed[bit / 8 + 1]) << 8 : 0);
+        
+        trip[i] = (bytes >> (bit % 8)) & 0x3F;
+    }
+}
+
+// all trips from the start to the finish up to length_max moves, packed and bucketed by length
+template<typename Board>
+void enumerateTrips(const int8_t& cell, const int8_t& finish_cell, Bitboard visited, vector<int8_t>& trip, const int8_t& length_max, vector<vector<uint8_t>>& packed_trips) {
+    int8_t move_count = trip.size() - 1;
+    
+    if(cell == finish_cell) {
+        vector<uint8_t>& bucket = packed_trips[move_count];
+        
+        bucket.resize(bucket.size() + packedTripSize(move_count));
+        packTrip(trip, &bucket[bucket.size() - packedTripSize(move_count)]);
+        return;
+    }
+    
+    for(Bitboard moves = Board::KNIGHT_ATTACKS[cell] & ~visited; moves; moves &= moves - 1) {
+        int8_t next_cell = __builtin_ctzll(moves);
+        
+        if(!Board::canReach(finish_cell, next_cell, move_count + 1, 0, length_max)) continue;
+        
+        trip.push_back(next_cell);
+        enumerateTrips<Board>(next_cell, finish_cell, visited | Bitboard(1) << next_cell, trip, length_max, packed_trips);
+        trip.pop_back();
+    }
+}
+
+// written through writeFileAtomically, so a killed run never leaves a broken store behind
+template<typename Board>
+bool writeTripsStore(const string& path, const vector<pair<int8_t, int8_t>>& directions, const int8_t& length_max) {
+    vector<TripsStoreEntry> entries;
+    vector<vector<uint8_t>> data;
+    uint64_t offset = sizeof(TripsStoreHeader) + directions.size() * (length_max + 1) * sizeof(TripsStoreEntry);
+    
+    for(auto& [start_cell, finish_cell] : directions) {
+        vector<vector<uint8_t>> packed_trips(length_max + 1);
+        vector<int8_t> trip = {start_cell};
+        
+        enumerateTrips<Board>(start_cell, finish_cell, Bitboard(1) << start_cell, trip, length_max, packed_trips);
+        
+        for(int8_t length = 0; length <= length_max; ++length) {
+            TripsStoreEntry entry = {};
+            entry.start_cell = start_cell;
+            entry.finish_cell = finish_cell;
+            entry.length = length;
+            entry.count = packed_trips[length].size() / packedTripSize(length);
+            entry.offset = offset;
+            
+            offset += packed_trips[length].size();
+            entries.push_back(entry);
+            data.push_back(move(packed_trips[length]));
+        }
+    }
+    
+    TripsStoreHeader header = {TRIPS_STORE_MAGIC, TRIPS_STORE_VERSION, uint32_t(Board::CELLS), uint32_t(entries.size())};
+    
+    return writeFileAtomically(path, [&header, &entries, &data](FILE* file) {
+        bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+        written &= fwrite(entries.data(), sizeof(TripsStoreEntry), entries.size(), file) == entries.size();
+        
+        for(const vector<uint8_t>& bytes : data) written &= fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        return written;
+    });
+}
+
+// read only view of a trips store file through mmap
+struct TripsStore {
+public:
+    ~TripsStore() {
+        if(data) munmap(data, size);
+    }
+    
+    // the trips only depend on the size of the board, not on its regions
+    bool open(const string& path, const uint32_t& board_cells) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) return false;
+        
+        struct stat st;
+        if(fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(TripsStoreHeader)) {
+            size = st.st_size;
+            void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(mapped != MAP_FAILED) data = static_cast<uint8_t*>(mapped);
+        }
+        
+        close(fd);
+        if(!data) return false;
+        
+        const TripsStoreHeader* header = reinterpret_cast<const TripsStoreHeader*>(data);
+        if(header->magic != TRIPS_STORE_MAGIC || header->version != TRIPS_STORE_VERSION || header->board_cells != board_cells) return false;
+        
+        entries = reinterpret_cast<const TripsStoreEntry*>(data + sizeof(TripsStoreHeader));
+        entries_count = header->entries_count;
+        
+        if(sizeof(TripsStoreHeader) + entries_count * sizeof(TripsStoreEntry) > size) return false;
+        
+        // a truncated or corrupted store must not send the scoring past the end of the mapping, its trips are checked when scored
+        for(size_t e = 0; e < entries_count; ++e) {
+            const TripsStoreEntry& entry = entries[e];
+            if(entry.length > 63 || entry.offset > size || entry.count > (size - entry.offset) / packedTripSize(entry.length)) return false;
+        }
+        
+        return true;
+    }
+    
+    // the entry of the trips of a direction with the given length, nullptr if the store doesn't go that far
+    const TripsStoreEntry* find(const int8_t& start_cell, const int8_t& finish_cell, const int8_t& length) {
+        for(size_t e = 0; e < entries_count; ++e) {
+            const TripsStoreEntry& entry = entries[e];
+            if(entry.start_cell == start_cell && entry.finish_cell == finish_cell && entry.length == length) return &entry;
+        }
+        
+        return nullptr;
+    }
+    
+    const uint8_t* getTrips(const TripsStoreEntry& entry) {
+        return data + entry.offset;
+    }
+    
+    int8_t getLengthMax() {
+        int8_t length_max = 0;
+        for(size_t e = 0; e < entries_count; ++e) length_max = max<int8_t>(length_max, entries[e].length);
+        
+        return length_max;
+    }
+private:
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    
+    const TripsStoreEntry* entries = nullptr;
+    size_t entries_count = 0;
+};
+
+template<typename Board>
+bool isStoredTripValid(const TripsStoreEntry& entry, const vector<int8_t>& trip) {
+    if(trip.front() != entry.start_cell || trip.back() != entry.finish_cell) return false;
+    
+    for(const int8_t& cell : trip) if(cell >= Board::CELLS) return false;
+    return true;
+}
+
+// scores the stored trips [begin, end) of an entry against the candidate boards of the finder
+template<typename Board>
+void scoreStoredTrips(TripsFinder& finder, CandidateBatch& batch, TripsStore& store, const TripsStoreEntry& entry, const size_t& begin, const size_t& end) {
+    size_t packed_size = packedTripSize(entry.length);
+    const uint8_t* packed = store.getTrips(entry) + begin * packed_size;
+    
+    vector<uint32_t> scores(batch.getStride()), next_scores(batch.getStride());
+    vector<int8_t> trip;
+    
+    for(size_t t = begin; t < end && !finder.getStopToken().isRequested(); ++t, packed += packed_size) {
+        unpackTrip(packed, entry.length, trip);
+        
+        // a corrupted trip would index the regions past the board, and isn't a trip of the entry anyway
+        if(!isStoredTripValid<Board>(entry, trip)) continue;
+        
+        bool reachable = batch.startScores(Board::CELL_REGIONS[trip[0]], scores.data());
+        
+        for(size_t i = 1; i < trip.size() && reachable; ++i) {
+            reachable = batch.stepScores(scores.data(), Board::CELL_REGIONS[trip[i - 1]], Board::CELL_REGIONS[trip[i]], next_scores.data());
+            swap(scores, next_scores);
+        }
+        
+        if(!reachable) continue;
+        
+        for(size_t k = 0; k < finder.getCandidateBoards().size(); ++k) {
+            if(scores[k] == TARGET_SCORE) finder.recordTrip(k, trip);
+        }
+    }
+}
+
+// ************************************************************************************
+
+const string CHECKPOINT_MAGIC = "knight-moves-checkpoint";
+const int CHECKPOINT_VERSION = 2;
+
+// a trip of a checkpoint with the direction it was found in and the map key of its candidate board
+struct CheckpointTrip {
+    int8_t direction;
+    size_t map_key;
+    vector<int8_t> trip;
+};
+
+/*
+ Frontier of a search: the pass to resume and a '1' for every prefix subtree of it already searched, none if the pass
+ starts over. The removed trips were published by the finished passes, the pass trips are the best ones of the pass to
+ resume so far. A checkpoint only resumes the search of the same board, target score and candidate boards, in the same order.
+ */
+struct SearchCheckpoint {
+    size_t cells = 0, target_score = 0;
+    vector<size_t> candidate_keys;
+    int length_min = 0;
+    string done_tasks;
+    vector<CheckpointTrip> removed_trips, pass_trips;
+};
+
+void writeCheckpointTrips(ostream& out, const string& name, const vector<CheckpointTrip>& trips) {
+    out << name << " " << trips.size() << "\n";
+    
+    for(const CheckpointTrip& trip : trips) {
+        out << int(trip.direction) << " " << trip.map_key << " " << trip.trip.size();
+        for(const int8_t& cell : trip.trip) out << " " << int(cell);
+        out << "\n";
+    }
+}
+
+bool readCheckpointTrips(istream& in, const string& name, const size_t& cells, vector<CheckpointTrip>& trips) {
+    string field;
+    size_t count = 0;
+    
+    if(!(in >> field >> count) || field != name) return false;
+    
+    trips.resize(count);
+    
+    for(CheckpointTrip& trip : trips) {
+        int direction = 0;
+        size_t length = 0;
+        
+        if(!(in >> direction >> trip.map_key >> length) || direction < 0 || direction > 1 || length == 0 || length > cells) return false;
+        
+        trip.direction = direction;
+        trip.trip.resize(length);
+        
+        for(int8_t& cell : trip.trip) {
+            int value = 0;
+            if(!(in >> value) || value < 0 || size_t(value) >= cells) return false;
+            
+            cell = value;
+        }
+    }
+    
+    return true;
+}
+
+bool writeSearchCheckpoint(const string& path, const SearchCheckpoint& checkpoint) {
+    ostringstream out;
+    
+    out << CHECKPOINT_MAGIC << " " << CHECKPOINT_VERSION << "\n";
+    out << "cells " << checkpoint.cells << " target " << checkpoint.target_score << "\n";
+    out << "candidates " << checkpoint.candidate_keys.size();
+    for(const size_t& map_key : checkpoint.candidate_keys) out << " " << map_key;
+    out << "\n";
+    out << "pass " << checkpoint.length_min << "\n";
+    out << "tasks " << (checkpoint.done_tasks.empty() ? "-" : checkpoint.done_tasks) << "\n";
+    
+    writeCheckpointTrips(out, "removed", checkpoint.removed_trips);
+    writeCheckpointTrips(out, "pass_trips", checkpoint.pass_trips);
+    
+    return writeFileAtomically(path, out.str());
+}
+
+bool readSearchCheckpoint(const string& path, SearchCheckpoint& checkpoint) {
+    ifstream in(path);
+    string magic, cells, target, candidates, pass, tasks;
+    int version = 0;
+    size_t candidates_count = 0;
+    
+    if(!(in >> magic >> version) || magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION) return false;
+    if(!(in >> cells >> checkpoint.cells >> target >> checkpoint.target_score) || cells != "cells" || target != "target") return false;
+    if(!(in >> candidates >> candidates_count) || candidates != "candidates") return false;
+    
+    checkpoint.candidate_keys.resize(candidates_count);
+    for(size_t& map_key : checkpoint.candidate_keys) if(!(in >> map_key)) return false;
+    
+    if(!(in >> pass >> checkpoint.length_min) || pass != "pass") return false;
+    if(!(in >> tasks >> checkpoint.done_tasks) || tasks != "tasks") return false;
+    
+    if(checkpoint.done_tasks == "-") checkpoint.done_tasks.clear();
+    if(checkpoint.done_tasks.find_first_not_of("01") != string::npos) return false;
+    
+    return readCheckpointTrips(in, "removed", checkpoint.cells, checkpoint.removed_trips) && readCheckpointTrips(in, "pass_trips", checkpoint.cells, checkpoint.pass_trips);
+}
+
+// the map keys of the candidate boards in their order, which is the order their results are resolved in
+vector<size_t> getCandidateKeys(const vector<CandidateBoard>& candidate_boards) {
+    vector<size_t> r;
+    for(CandidateBoard candidate : candidate_boards) r.push_back(candidate.getMapKey());
+    
+    return r;
+}
+
+// a checkpoint of another board, target or candidates would publish trips which don't score the search's target
+template<typename Board>
+bool canResume(const SearchCheckpoint& checkpoint, const vector<CandidateBoard>& candidate_boards) {
+    if(checkpoint.cells != Board::CELLS || checkpoint.target_score != TARGET_SCORE || checkpoint.candidate_keys != getCandidateKeys(candidate_boards)) return false;
+    if(checkpoint.length_min < TRIP_LENGTH_MIN || checkpoint.length_min > Board::TRIP_LENGTH_MAX) return false;
+    
+    // every pass starts at TRIP_LENGTH_MIN plus some windows
+    return (checkpoint.length_min - TRIP_LENGTH_MIN) % TRIP_LENGTH_WINDOW == 0;
+}
+
+// the trips of one direction, as the finders take them
+vector<pair<size_t, vector<int8_t>>> directionTrips(const vector<CheckpointTrip>& trips, const int8_t& direction) {
+    vector<pair<size_t, vector<int8_t>>> r;
+    for(const CheckpointTrip& trip : trips) if(trip.direction == direction) r.emplace_back(trip.map_key, trip.trip);
+    
+    return r;
+}
+
+/*
+ The checkpoint of the search as it is: between two passes only the removed trips, within a pass also the prefix subtrees
+ searched so far and the trips found. A task is flagged once its search is over, so its trips are always in.
+ */
+SearchCheckpoint takeCheckpoint(vector<TripsFinder*>& trip_finders, PassProgress& progress, const size_t& cells, const vector<size_t>& candidate_keys) {
+    SearchCheckpoint checkpoint;
+    checkpoint.cells = cells;
+    checkpoint.target_score = TARGET_SCORE;
+    checkpoint.candidate_keys = candidate_keys;
+    checkpoint.length_min = progress.length_min;
+    
+    if(progress.in_pass) {
+        for(const atomic<bool>& done : progress.done_tasks) checkpoint.done_tasks.push_back(done ? '1' : '0');
+    }
+    
+    for(TripsFinder* trip_finder : trip_finders) {
+        for(auto& [map_key, trip] : trip_finder->getRemovedTrips()) checkpoint.removed_trips.push_back({trip_finder->getDirection(), map_key, trip});
+        if(!progress.in_pass) continue;
+        
+        for(auto& [map_key, trip] : trip_finder->getPassTrips()) checkpoint.pass_trips.push_back({trip_finder->getDirection(), map_key, trip});
+    }
+    
+    return checkpoint;
+}
+
+// ************************************************************************************
+
+/*
+ The permutations of TARGET_ABC, or with abc_sum_max all the distinct A B C with A + B + C up to it, lowest sums first.
+ Scoring is shared per region signature, so a wide sweep costs little more than the permutations in the search itself.
+ The order only decides the answers of sweepTargets, a solve answers with the shortest trips match whatever its sum.
+ */
+vector<CandidateBoard> generateCandidateBoards(const int& abc_sum_max = 0) {
+    vector<CandidateBoard> r;
+    
+    if(abc_sum_max == 0) {
+        do {
+            r.emplace_back(TARGET_ABC[0], TARGET_ABC[1], TARGET_ABC[2]);
+        } while (std::next_permutation(TARGET_ABC.begin(), TARGET_ABC.end()));
+        
+        return r;
+    }
+    
+    for(int sum = 6; sum <= min(abc_sum_max, 3 * INT8_MAX); ++sum) {
+        for(int a = 1; a <= INT8_MAX && a < sum; ++a) {
+            for(int b = 1; b <= INT8_MAX && a + b < sum; ++b) {
+                int c = sum - a - b;
+                if(c > INT8_MAX || a == b || b == c || a == c) continue;
+                
+                int8_t value_a = a, value_b = b, value_c = c;
+                r.emplace_back(value_a, value_b, value_c);
+            }
+        }
+    }
+    
+    return r;
+}
+
+// ************************************************************************************
+
+string getStringOption(int argc, const char * argv[], const string& option, const string& default_value) {
+    for(int i = 1; i + 1 < argc; ++i) {
+        if(argv[i] == option) return argv[i + 1];
+    }
+    
+    return default_value;
+}
+
+int getOption(int argc, const char * argv[], const string& option, const int& default_value) {
+    string value = getStringOption(argc, argv, option, "");
+    return value.empty() ? default_value : stoi(value);
+}
+
+// number of worker threads, can be overridden with --threads N to measure the scaling
+size_t getThreadsCount(int argc, const char * argv[]) {
+    return max(getOption(argc, argv, "--threads", thread::hardware_concurrency()), 1);
+}
+
+bool hasFlag(int argc, const char * argv[], const string& flag) {
+    for(int i = 1; i < argc; ++i) if(argv[i] == flag) return true;
+    return false;
+}
+
+// depth-first search of all the trip lengths of the pass at once, split into prefix subtrees over the workers
+template<typename Board>
+void searchPass(vector<TripsFinder*>& trip_finders, vector<TripsSearch<Board>>& searches, const int8_t& length_min, PassProgress& progress, const string& resume_done_tasks) {
+    // prefixes must stay shorter than the trips, so a prefix never ends on the finish cell
+    int8_t split_depth = min<int8_t>(TRIP_PREFIX_DEPTH, length_min - 1);
+    
+    vector<vector<vector<int8_t>>> finder_prefixes;
+    size_t tasks_count = 0;
+    
+    for(TripsFinder* trip_finder : trip_finders) {
+        finder_prefixes.push_back(searches[0].split(*trip_finder, split_depth));
+        tasks_count += finder_prefixes.back().size();
+    }
+    
+    // interleave the directions so both of them advance together, as a match needs a trip in each
+    vector<pair<TripsFinder*, vector<int8_t>>> tasks;
+    
+    for(size_t i = 0; tasks.size() < tasks_count; ++i) {
+        for(size_t f = 0; f < trip_finders.size(); ++f) {
+            if(i < finder_prefixes[f].size()) tasks.emplace_back(trip_finders[f], finder_prefixes[f][i]);
+        }
+    }
+    
+    // the prefixes are the same for the same candidates, so the tasks a checkpoint has done are skipped
+    vector<size_t> pending;
+    
+    {
+        lock_guard<mutex> lock(progress.pass_mutex);
+        progress.done_tasks = vector<atomic<bool>>(tasks.size());
+        
+        for(size_t t = 0; t < tasks.size(); ++t) {
+            if(resume_done_tasks.size() == tasks.size() && resume_done_tasks[t] == '1') {
+                progress.done_tasks[t] = true;
+            } else {
+                pending.push_back(t);
+            }
+        }
+    }
+    
+    progress.tasks_done = tasks.size() - pending.size();
+    progress.tasks_count = tasks.size();
+    progress.start_ns = chrono::steady_clock::now().time_since_epoch().count();
+    
+    runWorkStealing(pending.size(), searches.size(), [&searches, &tasks, &progress, &pending](size_t worker, size_t task) {
+        size_t t = pending[task];
+        
+        searches[worker].search(*tasks[t].first, tasks[t].second);
+        progress.done_tasks[t] = true;
+        progress.tasks_done++;
+    });
+}
+
+// linear scan of the stored trips of the pass, split into chunks of trips over the workers, false if the store doesn't reach the pass
+template<typename Board>
+bool scoreStoredPass(vector<TripsFinder*>& trip_finders, TripsStore& store, const size_t& workers_count, const int8_t& length_min, const int8_t& length_max) {
+    const size_t chunk_size = 1 << 16;
+    
+    vector<CandidateBatch> batches(trip_finders.size());
+    vector<tuple<size_t, const TripsStoreEntry*, size_t>> tasks;
+    
+    for(size_t f = 0; f < trip_finders.size(); ++f) {
+        batches[f].assign(trip_finders[f]->getCandidateBoards());
+        
+        for(int8_t length = length_min; length <= length_max; ++length) {
+            const TripsStoreEntry* entry = store.find(trip_finders[f]->getStartCell(), trip_finders[f]->getFinishCell(), length);
+            
+            // the lengths of the window the store has are still scored
+            if(!entry) {
+                if(length == length_min) return false;
+                break;
+            }
+            
+            for(size_t begin = 0; begin < entry->count; begin += chunk_size) tasks.emplace_back(f, entry, begin);
+        }
+    }
+    
+    runWorkStealing(tasks.size(), workers_count, [&trip_finders, &batches, &store, &tasks, &chunk_size](size_t, size_t task) {
+        auto& [f, entry, begin] = tasks[task];
+        scoreStoredTrips<Board>(*trip_finders[f], batches[f], store, *entry, begin, min<size_t>(begin + chunk_size, entry->count));
+    });
+    
+    return true;
+}
+
+struct SolveOptions {
+    size_t threads_count = 1;
+    
+    // joins trip halves instead of searching whole trips, which is what makes long trips feasible
+    bool bidirectional = false;
+    
+    // scores the trips of a store instead of searching for them
+    TripsStore* store = nullptr;
+    
+    // writes the progress of the search as a JSON line this often, 0 for none
+    size_t progress_interval_ms = 0;
+    
+    // writes the frontier of the search to checkpoint_path this often and after every pass, if the path is set
+    string checkpoint_path;
+    size_t checkpoint_interval_ms = 0;
+    
+    // the checkpoint the search resumes from, its board and candidates were checked against the ones of the search
+    const SearchCheckpoint* resume = nullptr;
+};
+
+/*
+ One progress report: the pass, the counters summed over the workers with the nodes of each of them, and the time left in
+ the pass from the share of its prefix subtrees done. The search stops at the first match, so only the pass has an ETA.
+ */
+template<typename Board>
+void writeSearchProgress(ostream& out, const double& elapsed, vector<TripsSearch<Board>>& searches, const PassProgress& progress) {
+    size_t nodes = 0, leaves = 0, reach_prunes = 0, score_prunes = 0, length_prunes = 0;
+    ostringstream thread_nodes;
+    
+    for(size_t w = 0; w < searches.size(); ++w) {
+        const SearchCounters& counters = searches[w].getCounters();
+        
+        nodes += counters.nodes.get();
+        leaves += counters.leaves.get();
+        reach_prunes += counters.reach_prunes.get();
+        score_prunes += counters.score_prunes.get();
+        length_prunes += counters.length_prunes.get();
+        thread_nodes << (w ? "," : "") << counters.nodes.get();
+    }
+    
+    size_t tasks_done = progress.tasks_done, tasks_count = progress.tasks_count;
+    double pass_elapsed = (chrono::steady_clock::now().time_since_epoch().count() - progress.start_ns) / 1e9;
+    double pass_eta = tasks_done ? pass_elapsed * (tasks_count - tasks_done) / tasks_done : -1;
+    
+    out << fixed << setprecision(3) << "{\"elapsed_s\":" << elapsed << ",\"trip_length_min\":" << progress.length_min << ",\"trip_length_max\":" << progress.length_max
+        << ",\"tasks_done\":" << tasks_done << ",\"tasks_count\":" << tasks_count << ",\"nodes\":" << nodes << ",\"nodes_per_s\":" << (elapsed > 0 ? nodes / elapsed : 0)
+        << ",\"leaves\":" << leaves << ",\"prunes\":{\"reach\":" << reach_prunes << ",\"score\":" << score_prunes << ",\"length\":" << length_prunes << "}"
+        << ",\"thread_nodes\":[" << thread_nodes.str() << "],\"pass_eta_s\":" << pass_eta << "}";
+}
+
+/*
+ Searches trips of both directions with the same A B C out of the candidate boards, shortest trips first.
+ The first match stops every worker, and the search returns once they all wound down.
+ */
+template<typename Board>
+KnightMovesResult solve(const vector<CandidateBoard>& candidate_boards, const SolveOptions& options) {
+    StopToken stop_token;
+    ResultsTable results(candidate_boards, stop_token);
+    
+    TripsFinder tripFinder1 = TripsFinder(Board::TOP_LEFT, Board::BOTTOM_RIGHT, TRIP_A6F1_DIRECTION, candidate_boards, results, stop_token);
+    TripsFinder tripFinder2 = TripsFinder(Board::BOTTOM_LEFT, Board::TOP_RIGHT, TRIP_A1F6_DIRECTION, candidate_boards, results, stop_token);
+    vector<TripsFinder*> trip_finders = {&tripFinder1, &tripFinder2};
+    
+    // each worker has its own board and trip stack
+    vector<TripsSearch<Board>> searches(options.threads_count);
+    BidirectionalSearch<Board> bidirectional_search;
+    
+    PassProgress progress;
+    PeriodicThread reporter(options.progress_interval_ms, [&searches, &progress](const double& elapsed) {
+        ostringstream line;
+        writeSearchProgress<Board>(line, elapsed, searches, progress);
+        cerr << line.str() << endl;
+    });
+    
+    vector<size_t> candidate_keys = getCandidateKeys(candidate_boards);
+    
+    auto writeCheckpoint = [&options, &trip_finders, &progress, &candidate_keys]() {
+        if(!writeSearchCheckpoint(options.checkpoint_path, takeCheckpoint(trip_finders, progress, Board::CELLS, candidate_keys))) {
+            cerr << "Failed to write checkpoint " << options.checkpoint_path << endl;
+        }
+    };
+    
+    PeriodicThread checkpointer(options.checkpoint_path.empty() ? 0 : options.checkpoint_interval_ms, [&progress, &writeCheckpoint](const double&) {
+        lock_guard<mutex> lock(progress.pass_mutex);
+        if(progress.length_min > 0) writeCheckpoint();
+    });
+    
+    // the finished passes of a checkpoint are published again, and the pass it stopped in starts with the trips it had
+    int8_t first_length_min = TRIP_LENGTH_MIN;
+    
+    if(options.resume) {
+        first_length_min = options.resume->length_min;
+        for(TripsFinder* trip_finder : trip_finders) trip_finder->restoreRemovedTrips(directionTrips(options.resume->removed_trips, trip_finder->getDirection()));
+    }
+    
+    for(int8_t length_min = first_length_min; length_min <= Board::TRIP_LENGTH_MAX && !stop_token.isRequested(); length_min += TRIP_LENGTH_WINDOW) {
+        int8_t length_max = min<int8_t>(length_min + TRIP_LENGTH_WINDOW - 1, Board::TRIP_LENGTH_MAX);
+        bool resumed_pass = options.resume && length_min == first_length_min;
+        
+        {
+            lock_guard<mutex> lock(progress.pass_mutex);
+            
+            progress.length_min = length_min;
+            progress.length_max = length_max;
+            progress.done_tasks = vector<atomic<bool>>();
+            progress.in_pass = true;
+            
+            for(TripsFinder* trip_finder : trip_finders) {
+                trip_finder->startPass(length_min, length_max);
+                if(resumed_pass) trip_finder->restorePassTrips(directionTrips(options.resume->pass_trips, trip_finder->getDirection()));
+            }
+        }
+        
+        if(options.store) {
+            // the store doesn't reach this pass
+            if(!scoreStoredPass<Board>(trip_finders, *options.store, options.threads_count, length_min, length_max)) break;
+        } else if(options.bidirectional) {
+            for(int8_t length = length_min; length <= length_max; ++length) {
+                for(TripsFinder* trip_finder : trip_finders) bidirectional_search.search(*trip_finder, length);
+            }
+        } else {
+            searchPass<Board>(trip_finders, searches, length_min, progress, resumed_pass ? options.resume->done_tasks : "");
+        }
+        
+        lock_guard<mutex> lock(progress.pass_mutex);
+        
+        for(TripsFinder* trip_finder : trip_finders) trip_finder->publishTrips();
+        
+        // a stopped pass is not over, as its workers wound down early
+        if(stop_token.isRequested()) break;
+        
+        progress.length_min = length_min + TRIP_LENGTH_WINDOW;
+        progress.length_max = length_max + TRIP_LENGTH_WINDOW;
+        progress.in_pass = false;
+        
+        if(!options.checkpoint_path.empty()) writeCheckpoint();
+    }
+    
+    KnightMovesResult result = results.getResult();
+    for(TripsSearch<Board>& search : searches) result.nodes_count += search.getNodesCount();
+    
+    return result;
+}
+
+/*
+ Answers every target score in [target_min, target_max] from a single walk over the trips up to length_max moves of both
+ directions, instead of one solve per target. A target is answered by the first candidate board, in the order they were
+ generated, which has a trip in both directions with that score. Returns the number of targets answered.
+ */
+template<typename Board>
+size_t sweepTargets(const vector<CandidateBoard>& candidate_boards, const size_t& threads_count, const size_t& target_min, const size_t& target_max, const int8_t& length_max) {
+    CandidateBatch batch;
+    batch.assign(candidate_boards, target_max + 1);
+    
+    vector<ScoreSweep<Board>> sweeps(threads_count, ScoreSweep<Board>(batch, candidate_boards.size(), target_max, length_max));
+    
+    vector<tuple<int8_t, int8_t, int8_t>> directions = {
+        {TRIP_A6F1_DIRECTION, Board::TOP_LEFT, Board::BOTTOM_RIGHT},
+        {TRIP_A1F6_DIRECTION, Board::BOTTOM_LEFT, Board::TOP_RIGHT},
+    };
+    
+    // prefixes must stay shorter than the trips, the shorter trips are already indexed by the split
+    int8_t split_depth = min<int8_t>(TRIP_PREFIX_DEPTH, length_max);
+    vector<pair<int8_t, vector<int8_t>>> tasks;
+    
+    for(auto& [direction, start_cell, finish_cell] : directions) {
+        for(vector<int8_t>& prefix : sweeps[0].split(direction, start_cell, finish_cell, split_depth)) tasks.emplace_back(direction, prefix);
+    }
+    
+    runWorkStealing(tasks.size(), sweeps.size(), [&sweeps, &tasks, &directions](size_t worker, size_t task) {
+        int8_t direction = tasks[task].first;
+        sweeps[worker].search(direction, get<2>(directions[direction]), tasks[task].second);
+    });
+    
+    for(size_t w = 1; w < sweeps.size(); ++w) {
+        for(auto& [direction, start_cell, finish_cell] : directions) sweeps[0].getIndex(direction).merge(sweeps[w].getIndex(direction));
+    }
+    
+    // ************************************************************************************
+    
+    ScoreIndex& index_a6f1 = sweeps[0].getIndex(TRIP_A6F1_DIRECTION);
+    ScoreIndex& index_a1f6 = sweeps[0].getIndex(TRIP_A1F6_DIRECTION);
+    size_t answered = 0;
+    
+    for(size_t target = target_min; target <= target_max; ++target) {
+        for(size_t k = 0; k < candidate_boards.size(); ++k) {
+            if(!index_a6f1.hasTrip(k, target) || !index_a1f6.hasTrip(k, target)) continue;
+            
+            CandidateBoard candidate = candidate_boards[k];
+            cout << target << ": " << static_cast<int>(candidate.getA()) << "," << static_cast<int>(candidate.getB()) << "," << static_cast<int>(candidate.getC()) << ",";
+            
+            printTrip<Board>(index_a1f6.getTrip(k, target));
+            cout << ",";
+            printTrip<Board>(index_a6f1.getTrip(k, target));
+            cout << endl;
+            
+            answered++;
+            break;
+        }
+    }
+    
+    return answered;
+}
+
+// ************************************************************************************
+
+// keeps the results of the benchmarked kernels alive, so the compiler can't drop the work
+volatile size_t benchmark_sink = 0;
+
+// best of a few runs, in seconds, so a run slowed down by the rest of the machine doesn't count
+double timeBest(const int& repeats, const function<void()>& run) {
+    double best = 0;
+    
+    for(int r = 0; r < repeats; ++r) {
+        auto start = chrono::steady_clock::now();
+        run();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        
+        if(r == 0 || seconds < best) best = seconds;
+    }
+    
+    return best;
+}
+
+/*
+ Microbenchmarks of the kernels on fixed inputs, then the solver end to end from 1 thread up to threads_max, doubling.
+ Run with --benchmark, every figure is the best of --benchmark-repeats runs.
+ */
+template<typename Board>
+void runBenchmarks(const vector<CandidateBoard>& candidate_boards, const size_t& threads_max, const int& repeats) {
+    cout << fixed << setprecision(3);
+    
+    // one score step of a wide candidate sweep, on the widest kernel the CPU supports, with every lane still below the target
+    CandidateBatch batch;
+    batch.assign(generateCandidateBoards(60));
+    
+    size_t stride = batch.getStride();
+    vector<uint32_t> prev_scores(stride), next_scores(stride);
+    mt19937 random(2024);
+    
+    for(uint32_t& score : prev_scores) score = random() % 1000;
+    
+    const int steps_count = 2'000;
+    double seconds = timeBest(repeats, [&batch, &prev_scores, &next_scores, &steps_count]() {
+        for(int step = 0; step < steps_count; ++step) benchmark_sink = benchmark_sink + batch.stepScores(prev_scores.data(), step % 3, step / 3 % 3, next_scores.data());
+    });
+    
+    cout << "stepScores: " << steps_count * stride / seconds / 1e6 << " M candidate steps/s" << endl;
+    
+    // ************************************************************************************
+    
+    // TripsSearch::move over two passes worth of lengths of one direction, which can't match so it never stops early
+    size_t nodes_count = 0;
+    
+    seconds = timeBest(repeats, [&candidate_boards, &nodes_count]() {
+        StopToken stop_token;
+        ResultsTable results(candidate_boards, stop_token);
+        TripsFinder finder(Board::TOP_LEFT, Board::BOTTOM_RIGHT, TRIP_A6F1_DIRECTION, candidate_boards, results, stop_token);
+        TripsSearch<Board> search;
+        
+        finder.startPass(TRIP_LENGTH_MIN, min<int8_t>(TRIP_LENGTH_MIN + 2 * TRIP_LENGTH_WINDOW - 1, Board::TRIP_LENGTH_MAX));
+        search.search(finder, {Board::TOP_LEFT});
+        nodes_count = search.getNodesCount();
+    });
+    
+    cout << "TripsSearch::move: " << nodes_count << " nodes, " << nodes_count / seconds / 1e6 << " M nodes/s" << endl;
+    
+    // ************************************************************************************
+    
+    double single_thread_seconds = 0;
+    
+    for(size_t threads_count = 1; threads_count <= threads_max; threads_count = threads_count < threads_max ? min(threads_count * 2, threads_max) : threads_count + 1) {
+        SolveOptions options;
+        options.threads_count = threads_count;
+        
+        KnightMovesResult result;
+        seconds = timeBest(repeats, [&candidate_boards, &options, &result]() {
+            result = solve<Board>(candidate_boards, options);
+        });
+        
+        if(threads_count == 1) single_thread_seconds = seconds;
+        
+        cout << "solve, " << threads_count << " threads: " << seconds * 1000 << " ms, " << result.nodes_count / seconds / 1e6 << " M nodes/s, speedup " << single_thread_seconds / seconds << endl;
+    }
+}
+
+// runs the puzzle on the board compiled for the layout, the exit code is the one of main
+template<typename Board>
+int runPuzzle(int argc, const char * argv[], const vector<CandidateBoard>& candidate_boards) {
+    
+    // --benchmark times the kernels and the solver up to --threads workers
+    if(hasFlag(argc, argv, "--benchmark")) {
+        runBenchmarks<Board>(candidate_boards, getThreadsCount(argc, argv), max(getOption(argc, argv, "--benchmark-repeats", 3), 1));
+        return 0;
+    }
+    
+    // --write-trips PATH enumerates every trip up to --trips-length-max moves once and stores it for later runs
+    string write_trips_path = getStringOption(argc, argv, "--write-trips", "");
+    
+    if(!write_trips_path.empty()) {
+        int8_t length_max = min(getOption(argc, argv, "--trips-length-max", 16), int(Board::TRIP_LENGTH_MAX));
+        vector<pair<int8_t, int8_t>> directions = {
+            {Board::TOP_LEFT, Board::BOTTOM_RIGHT},
+            {Board::BOTTOM_LEFT, Board::TOP_RIGHT},
+        };
+        
+        bool written = writeTripsStore<Board>(write_trips_path, directions, length_max);
+        cout << (written ? "Trips stored in " : "Failed to store trips in ") << write_trips_path << endl;
+        return written ? 0 : 1;
+    }
+    
+    /*
+     --sweep-targets N answers every target score from --sweep-targets-min (1 by default) up to N at once,
+     out of the trips up to --sweep-length-max moves
+     */
+    int sweep_target_max = getOption(argc, argv, "--sweep-targets", 0);
+    
+    if(sweep_target_max > 0) {
+        int sweep_target_min = max(getOption(argc, argv, "--sweep-targets-min", 1), 1);
+        int8_t length_max = min(getOption(argc, argv, "--sweep-length-max", 16), int(Board::TRIP_LENGTH_MAX));
+        
+        // the candidate scores are kept in 32 bit lanes, like the ones of TARGET_SCORE
+        if(uint64_t(sweep_target_max + 1) * INT8_MAX > UINT32_MAX) {
+            cout << "Targets up to " << sweep_target_max << " don't fit the score lanes" << endl;
+            return 1;
+        }
+        
+        size_t answered = sweepTargets<Board>(candidate_boards, getThreadsCount(argc, argv), sweep_target_min, sweep_target_max, length_max);
+        cout << "Answered " << answered << " of " << max(sweep_target_max - sweep_target_min + 1, 0) << " targets" << endl;
+        return 0;
+    }
+    
+    SolveOptions options;
+    options.threads_count = getThreadsCount(argc, argv);
+    options.bidirectional = hasFlag(argc, argv, "--bidirectional");
+    
+    // --progress MS writes the counters of the search to stderr as a JSON line every MS milliseconds
+    options.progress_interval_ms = max(getOption(argc, argv, "--progress", 0), 0);
+    
+    /*
+     --checkpoint PATH writes the frontier of the search to PATH after every pass and every --checkpoint-interval seconds
+     (60 by default), --resume starts from the checkpoint of PATH instead of the first pass
+     */
+    options.checkpoint_path = getStringOption(argc, argv, "--checkpoint", "");
+    options.checkpoint_interval_ms = max(getOption(argc, argv, "--checkpoint-interval", 60), 1) * 1000;
+    
+    SearchCheckpoint checkpoint;
+    
+    if(hasFlag(argc, argv, "--resume")) {
+        if(!readSearchCheckpoint(options.checkpoint_path, checkpoint) || !canResume<Board>(checkpoint, candidate_boards)) {
+            cout << "Failed to resume from checkpoint " << options.checkpoint_path << endl;
+            return 1;
+        }
+        
+        options.resume = &checkpoint;
+    }
+    
+    // --read-trips PATH scores the trips of a store instead of searching for them
+    string read_trips_path = getStringOption(argc, argv, "--read-trips", "");
+    TripsStore store;
+    
+    if(!read_trips_path.empty()) {
+        if(!store.open(read_trips_path, Board::CELLS)) {
+            cout << "Failed to read trips from " << read_trips_path << endl;
+            return 1;
+        }
+        
+        options.store = &store;
+    }
+    
+    KnightMovesResult result = solve<Board>(candidate_boards, options);
+    
+    if(!result.found) {
+        if(options.store && store.getLengthMax() < Board::TRIP_LENGTH_MAX) cout << "Trips not found, the store only goes up to " << int(store.getLengthMax()) << " moves" << endl;
+        else cout << "Trips not found :(" << endl;
+        
+        return 0;
+    }
+    
+    printResult<Board>(result);
+    return 1;
+}
+
+int main(int argc, const char * argv[]) {
+    
+    // --abc-sum-max N sweeps all the distinct A B C up to that sum instead of the permutations of TARGET_ABC, the solve
+    // then answers with the candidate of the shortest trips, which isn't necessarily the one of the lowest sum
+    vector<CandidateBoard> candidate_boards = generateCandidateBoards(getOption(argc, argv, "--abc-sum-max", 0));
+    
+    if(hasFlag(argc, argv, "--check-kernels")) {
+        vector<ScoreKernel> tested_kernels;
+        bool valid = checkScoreKernels(generateCandidateBoards(60), tested_kernels);
+        
+        if(tested_kernels.empty()) {
+            cout << "No SIMD score kernel is supported by this CPU, only the scalar one is used" << endl;
+            return 0;
+        }
+        
+        cout << "Score kernels " << (valid ? "match" : "differ") << ":";
+        for(ScoreKernel kernel : tested_kernels) cout << " " << getKernelName(kernel);
+        cout << endl;
+        
+        return valid ? 0 : 1;
+    }
+    
+    // --board 5 or 8 runs the same search on the other layouts, the puzzle itself is the 6x6 board
+    switch(getOption(argc, argv, "--board", KnightMoves6Board::SIZE)) {
+        case KnightMoves5Board::SIZE: return runPuzzle<KnightMoves5Board>(argc, argv, candidate_boards);
+        case KnightMoves6Board::SIZE: return runPuzzle<KnightMoves6Board>(argc, argv, candidate_boards);
+        case KnightMoves8Board::SIZE: return runPuzzle<KnightMoves8Board>(argc, argv, candidate_boards);
+    }
+    
+    cout << "No layout for this board size" << endl;
+    return 1;
 }
@@ -2,283 +2,1196 @@
 
 #include <iostream>
 #include <cinttypes>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <functional>
 #include <unordered_set>
 #include <map>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <condition_variable>
+#include <cstdio>
+
+#include <unistd.h>
 
 using namespace std;
 
 // ************************************************************************************
 
-class SomewhatSquareSudoku {
-public:
+// number of orders of the 9 digits of a sudoku number, the most candidates a multiple can have
+const int DIGITS_PERMUTATIONS = 362'880;
+
+/*
+ Digits of every group of 3 decimal digits, leading zeros included, packed as 4 bits per digit from the last one.
+ The mask has a bit per digit and is 0 if a digit repeats. A sudoku number is three groups, and the leading zero
+ of the high group is the 0 an 8 digits number has in its first column.
+ */
+struct DigitsGroup {
+    uint16_t packed, mask;
+};
+
+array<DigitsGroup, 1000> generateDigitsGroups() {
+    array<DigitsGroup, 1000> r;
     
-    // solve the puzzle and returns the number formed by the middle row in the completed grid.
-    int solve() {
+    for(int number = 0; number < 1000; ++number) {
+        uint8_t digits[3] = {uint8_t(number % 10), uint8_t(number / 10 % 10), uint8_t(number / 100)};
         
-        // all possible remaining digits for second row number (already contain 2 and 5)
-        vector<uint8_t> digits = {0, 1, 3, 4, 6, 7, 8, 9}, subset;
-        uint8_t placements_count = 7, digits_size = 8;
+        r[number].packed = digits[0] | digits[1] << 4 | digits[2] << 8;
+        r[number].mask = (1 << digits[0]) | (1 << digits[1]) | (1 << digits[2]);
         
-        subset.reserve(placements_count);
+        if(digits[0] == digits[1] || digits[1] == digits[2] || digits[0] == digits[2]) r[number].mask = 0;
+    }
+    
+    return r;
+}
+
+const array<DigitsGroup, 1000> DIGITS_GROUPS = generateDigitsGroups();
+
+// a 1 in the lowest bit of every digit, and in the highest, of a packed sudoku number
+const uint64_t PACKED_DIGITS_LOW = 0x111'111'111;
+const uint64_t PACKED_DIGITS_HIGH = 0x888'888'888;
+
+// constraints on sudoku possible numbers
+const int MIN_NUMBER = 12'345'678, MAX_NUMBER = 987'654'321;
+
+// numbers one range of a search steps through, so the many multiples of a small divisor spread over the workers
+const int RANGE_STEPS = 1 << 16;
+
+// primes up to the square root of the largest sudoku number are enough to factorize any of them
+const int PRIMES_LIMIT = 31'427;
 
-        vector<bool> mask(digits.size(), false);
-        fill(mask.begin(), mask.begin() + placements_count, true);
+vector<int> generatePrimes(const int& limit) {
+    vector<bool> composite(limit + 1, false);
+    vector<int> r;
+    
+    for(int i = 2; i <= limit; ++i) {
+        if(composite[i]) continue;
         
-        // sorted list of divisors with relation to its multiples (possible second row numbers)
-        map<int, vector<int>, greater<int>> divisors;
+        r.push_back(i);
+        for(int64_t j = int64_t(i) * i; j <= limit; j += i) composite[j] = true;
+    }
+    
+    return r;
+}
 
-        do {
-            // all numbers must contain 0
-            if(mask[0] == false) continue;
-            
-            subset.clear();
-            for (size_t i = 0; i < digits_size; ++i) if (mask[i]) subset.push_back(digits[i]);
+const vector<int> PRIMES = generatePrimes(PRIMES_LIMIT);
 
-            do {
-                if(subset[2] == 0) continue;
-                
-                int num = subsetToInt(subset, placements_count);
-                findDivisors(num, divisors);
-            } while(next_permutation(subset.begin(), subset.end()));
+// ************************************************************************************
+
+/*
+ A cell of a sudoku number is bit j * 10 + d of a mask, digit d in the column j counted from the last one, the order
+ the digits are packed in. A candidate fits a row when it has all the required cells of the row and none of the forbidden
+ ones, which are the digits given in the same column or in the same box in another row.
+ */
+typedef unsigned __int128 CellsMask;
+
+inline CellsMask cellBit(const uint8_t& j, const uint8_t& digit) {
+    return CellsMask(1) << (j * 10 + digit);
+}
+
+struct SudokuGivens {
+    // the digit given in a row and column, columns counted from the first one, -1 if there is none
+    int8_t cells[9][9];
+    CellsMask required[9] = {0}, forbidden[9] = {0};
+    
+    // every row of the grid has all the digits given anywhere in it
+    int digits_mask = 0;
+    
+    // the row with the most givens, its numbers are the multiples the search starts from
+    uint8_t seed_row = 0;
+};
+
+// the givens of the puzzle, a digit or '.' for every cell
+const vector<string> PUZZLE_GIVENS = {
+    ".......2.",
+    "....2...5",
+    ".2.......",
+    "..0......",
+    ".........",
+    "...2.....",
+    "....0....",
+    ".....2...",
+    "......5..",
+};
+
+bool compileGivens(const vector<string>& lines, SudokuGivens& givens) {
+    if(lines.size() != 9) return false;
+    
+    for(uint8_t row = 0; row < 9; ++row) {
+        if(lines[row].size() != 9) return false;
+        
+        for(uint8_t column = 0; column < 9; ++column) {
+            char c = lines[row][column];
+            if(c != '.' && (c < '0' || c > '9')) return false;
             
-        } while(prev_permutation(mask.begin(), mask.end()));
+            givens.cells[row][column] = c == '.' ? -1 : c - '0';
+        }
+    }
+    
+    // ************************************************************************************
+    
+    size_t seed_count = 0;
+    
+    for(uint8_t row = 0; row < 9; ++row) {
+        size_t count = 0;
+        uint16_t row_digits = 0;
         
-        // ************************************************************************************
+        for(uint8_t column = 0; column < 9; ++column) {
+            int8_t digit = givens.cells[row][column];
+            if(digit < 0) continue;
+            
+            // the forbidden masks only cover the other rows, so a digit repeated within the row is caught here
+            if(row_digits & 1 << digit) return false;
+            row_digits |= 1 << digit;
+            
+            count++;
+            givens.digits_mask |= 1 << digit;
+            givens.required[row] |= cellBit(8 - column, digit);
+            
+            for(uint8_t other = 0; other < 9; ++other) {
+                if(other == row) continue;
+                
+                givens.forbidden[other] |= cellBit(8 - column, digit);
+                
+                if(other / 3 != row / 3) continue;
+                for(uint8_t box_column = column / 3 * 3; box_column < column / 3 * 3 + 3; ++box_column) givens.forbidden[other] |= cellBit(8 - box_column, digit);
+            }
+        }
         
-        // constraints on sudoku possible numbers
-        int min_number = 12'345'678, max_number = 987'654'321;
+        if(count > seed_count) {
+            seed_count = count;
+            givens.seed_row = row;
+        }
+    }
+    
+    // two givens of a digit in a row, column or box
+    for(uint8_t row = 0; row < 9; ++row) if(givens.required[row] & givens.forbidden[row]) return false;
+    
+    return true;
+}
 
-        for(auto& [k, multiples] : divisors) {
+// a givens file has 9 lines of 9 cells, blank lines and spaces are skipped
+bool loadGivens(const string& path, SudokuGivens& givens) {
+    ifstream file(path);
+    if(!file) return false;
+    
+    vector<string> lines;
+    string line;
+    
+    while(getline(file, line)) {
+        line.erase(remove_if(line.begin(), line.end(), [](const char& c){return c == ' ' || c == '\t' || c == '\r';}), line.end());
+        if(!line.empty()) lines.push_back(line);
+    }
+    
+    return compileGivens(lines, givens);
+}
+
+// ************************************************************************************
+
+/*
+ Candidates accepted by one range of the search of a (divisor, multiple), only written by the worker running the range.
+ The candidates of a row are stored back to back, 9 digits each, so adding one doesn't allocate once the buffer has grown.
+ */
+struct CandidateBuffers {
+    vector<uint8_t> rows[9];
+    size_t len9 = 0, len8 = 0;
+};
+
+// all the ranges of a (divisor, multiple), the worker finishing the last of them merges their buffers and assembles the grid
+struct MultipleSearch {
+    int divisor, multiple;
+    vector<CandidateBuffers> ranges;
+    atomic<size_t> remaining_ranges{0};
+    
+    // set once the grid was tried and, if there was one, the answer taken
+    atomic<bool> finished{false};
+};
+
+// ************************************************************************************
+
+/*
+ Knuth's Algorithm X with dancing links. Node 0 is the root, nodes 1..items_count are the item headers linked left and right
+ from it, and every option is a row of nodes linked left and right, each linked up and down with the other nodes of its item.
+ Covering an item unlinks it and every option using it, and uncovering relinks them in the reverse order.
+ */
+class DancingLinks {
+public:
+    DancingLinks(const size_t& items_count) {
+        for(size_t i = 0; i <= items_count; ++i) {
+            left.push_back(i == 0 ? items_count : i - 1);
+            right.push_back(i == items_count ? 0 : i + 1);
+            up.push_back(i);
+            down.push_back(i);
+            item.push_back(i);
+            option.push_back(-1);
+        }
+        
+        sizes.assign(items_count + 1, 0);
+    }
+    
+    // items are numbered from 1, the option is numbered by the order it was added in
+    void addOption(const vector<size_t>& items) {
+        size_t first = left.size();
+        
+        for(size_t k = 0; k < items.size(); ++k) {
+            size_t node = left.size(), i = items[k];
             
-            // to be able to bind as a reference in threads
-            int divisor = k;
+            left.push_back(k == 0 ? first + items.size() - 1 : node - 1);
+            right.push_back(k + 1 == items.size() ? first : node + 1);
+            up.push_back(up[i]);
+            down.push_back(i);
+            item.push_back(i);
+            option.push_back(options_count);
             
-            for(int& multiple : multiples) {
-                size_t valid_candidates_len9 = 0, valid_candidates_len8 = 0;
+            down[up[i]] = node;
+            up[i] = node;
+            sizes[i]++;
+        }
+        
+        options_count++;
+    }
+    
+    // the options of the first exact cover found, false if there is none
+    bool search(vector<int>& solution) {
+        if(right[0] == 0) return true;
+        
+        // the item with the fewest options left
+        size_t c = right[0];
+        for(size_t i = right[c]; i != 0; i = right[i]) if(sizes[i] < sizes[c]) c = i;
+        
+        if(sizes[c] == 0) return false;
+        
+        cover(c);
+        
+        for(size_t r = down[c]; r != c; r = down[r]) {
+            solution.push_back(option[r]);
+            for(size_t j = right[r]; j != r; j = right[j]) cover(item[j]);
+            
+            if(search(solution)) return true;
+            
+            for(size_t j = left[r]; j != r; j = left[j]) uncover(item[j]);
+            solution.pop_back();
+        }
+        
+        uncover(c);
+        return false;
+    }
+private:
+    vector<size_t> left, right, up, down, item, sizes;
+    vector<int> option;
+    int options_count = 0;
+    
+    void cover(const size_t& c) {
+        left[right[c]] = left[c];
+        right[left[c]] = right[c];
+        
+        for(size_t i = down[c]; i != c; i = down[i]) {
+            for(size_t j = right[i]; j != i; j = right[j]) {
+                up[down[j]] = up[j];
+                down[up[j]] = down[j];
+                sizes[item[j]]--;
+            }
+        }
+    }
+    
+    void uncover(const size_t& c) {
+        for(size_t i = up[c]; i != c; i = up[i]) {
+            for(size_t j = left[i]; j != i; j = left[j]) {
+                sizes[item[j]]++;
+                up[down[j]] = j;
+                down[up[j]] = j;
+            }
+        }
+        
+        left[right[c]] = c;
+        right[left[c]] = c;
+    }
+};
 
-                vector<vector<vector<uint8_t>>> valid_candidates(9);
-                
-                // ************************************************************************************
-                
-                mutex mtx;
+// ************************************************************************************
+
+// a counter of a single thread, an increment is a plain load and store which the reporter thread can read at any time
+struct Counter {
+public:
+    void add(const size_t& n = 1) {
+        value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed);
+    }
+    
+    size_t get() const {
+        return value.load(memory_order_relaxed);
+    }
+private:
+    atomic<size_t> value{0};
+};
+
+// counters of one worker, on cache lines of their own so the workers never write to a shared line
+struct alignas(64) WorkerCounters {
+    Counter candidates, searches;
+    
+    // candidates rejected as both numbers have 8 digits, for a repeated digit, for other digits than the multiple,
+    // for a digit in the same column as in the multiple, and as they fit the givens of no row
+    Counter short_rejects, repeat_rejects, digits_rejects, column_rejects, givens_rejects;
+    Counter accepted[9];
+    
+    // divisor of the search the worker is in
+    atomic<int> divisor{0};
+};
+
+/*
+ Calls run every interval_ms with the seconds elapsed since it was created, from its own thread, until it is destroyed.
+ The progress reports and the checkpoints run this way, so the workers never wait for them.
+ */
+class PeriodicThread {
+public:
+    PeriodicThread(const size_t& interval_ms, const function<void(const double&)>& run): interval_ms(interval_ms), run(run), start(chrono::steady_clock::now()) {
+        if(interval_ms > 0) reporter = thread([this]() { loop(); });
+    }
+    
+    ~PeriodicThread() {
+        if(!reporter.joinable()) return;
+        
+        {
+            lock_guard<mutex> lock(stop_mutex);
+            stopped = true;
+        }
+        
+        stop_condition.notify_one();
+        reporter.join();
+    }
+private:
+    size_t interval_ms;
+    function<void(const double&)> run;
+    chrono::steady_clock::time_point start;
+    
+    thread reporter;
+    mutex stop_mutex;
+    condition_variable stop_condition;
+    bool stopped = false;
+    
+    void loop() {
+        unique_lock<mutex> lock(stop_mutex);
+        
+        while(!stop_condition.wait_for(lock, chrono::milliseconds(interval_ms), [this]() { return stopped; })) {
+            run(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        }
+    }
+};
+
+// ************************************************************************************
+
+// keeps the results of the benchmarked kernels alive, so the compiler can't drop the work
+volatile size_t benchmark_sink = 0;
+
+// best of a few runs, in seconds, so a run slowed down by the rest of the machine doesn't count
+double timeBest(const int& repeats, const function<void()>& run) {
+    double best = 0;
+    
+    for(int r = 0; r < repeats; ++r) {
+        auto start = chrono::steady_clock::now();
+        run();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        
+        if(r == 0 || seconds < best) best = seconds;
+    }
+    
+    return best;
+}
+
+// ************************************************************************************
+
+const string CHECKPOINT_MAGIC = "somewhat-square-sudoku-checkpoint";
+const int CHECKPOINT_VERSION = 1;
+
+/*
+ Frontier of a search: the searches before frontier are over, the last of them being the (divisor, multiple) pair given,
+ and found_search is the first of them with a grid, or searches_count if none had one. A checkpoint only resumes the
+ search of the same givens.
+ */
+struct SudokuCheckpoint {
+    string givens;
+    size_t searches_count = 0, frontier = 0, found_search = 0;
+    int divisor = 0, multiple = 0, answer = 0;
+};
+
+// the givens as a single string, row by row, for the checkpoints
+string givensKey(const SudokuGivens& givens) {
+    string r;
+    
+    for(uint8_t row = 0; row < 9; ++row) {
+        for(uint8_t column = 0; column < 9; ++column) r.push_back(givens.cells[row][column] < 0 ? '.' : '0' + givens.cells[row][column]);
+    }
+    
+    return r;
+}
+
+// the file is written and synced next to its final path and renamed over it, so a killed run keeps the last checkpoint
+bool writeFileAtomically(const string& path, const string& content) {
+    string temp_path = path + ".tmp";
+    FILE* file = fopen(temp_path.c_str(), "wb");
+    if(!file) return false;
+    
+    bool written = fwrite(content.data(), 1, content.size(), file) == content.size();
+    written &= fflush(file) == 0 && fsync(fileno(file)) == 0;
+    written &= fclose(file) == 0;
+    
+    return written && rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+bool writeSudokuCheckpoint(const string& path, const SudokuCheckpoint& checkpoint) {
+    ostringstream out;
+    
+    out << CHECKPOINT_MAGIC << " " << CHECKPOINT_VERSION << "\n";
+    out << "givens " << checkpoint.givens << "\n";
+    out << "searches " << checkpoint.searches_count << "\n";
+    out << "finished " << checkpoint.frontier << " " << checkpoint.divisor << " " << checkpoint.multiple << "\n";
+    out << "found " << checkpoint.found_search << " " << checkpoint.answer << "\n";
+    
+    return writeFileAtomically(path, out.str());
+}
+
+bool readSudokuCheckpoint(const string& path, SudokuCheckpoint& checkpoint) {
+    ifstream in(path);
+    string magic, givens, searches, finished, found;
+    int version = 0;
+    
+    if(!(in >> magic >> version) || magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION) return false;
+    if(!(in >> givens >> checkpoint.givens) || givens != "givens") return false;
+    if(!(in >> searches >> checkpoint.searches_count) || searches != "searches") return false;
+    if(!(in >> finished >> checkpoint.frontier >> checkpoint.divisor >> checkpoint.multiple) || finished != "finished") return false;
+    if(!(in >> found >> checkpoint.found_search >> checkpoint.answer) || found != "found") return false;
+    
+    return checkpoint.frontier <= checkpoint.searches_count && checkpoint.found_search <= checkpoint.searches_count;
+}
+
+// ************************************************************************************
+
+// how a grid is assembled out of the candidates of its rows, COMPARE runs both and times them
+enum class GridBackend {
+    BACKTRACKING,
+    DLX,
+    COMPARE,
+};
+
+class SomewhatSquareSudoku {
+public:
+    SomewhatSquareSudoku(const SudokuGivens& givens, const GridBackend& backend = GridBackend::BACKTRACKING, const size_t& threads_count = max(thread::hardware_concurrency(), 1u), const size_t& progress_interval_ms = 0): threads_count(threads_count), givens(givens), backend(backend), progress_interval_ms(progress_interval_ms), worker_counters(threads_count) {}
+    
+    // solve the puzzle, the answer is the number formed by the middle row in the completed grid. Returns false if there is no grid.
+    bool solve(int& answer) {
+        
+        // all possible seed row numbers, their divisors are found in parallel afterwards
+        vector<int> numbers;
+        listSeedNumbers(8, 0, 0, numbers);
+        
+        // every worker takes a contiguous part of the numbers, so merging their maps in order keeps the order of the multiples
+        vector<map<int, vector<int>, greater<int>>> worker_divisors(threads_count);
+        vector<thread> divisors_workers;
+        
+        for(size_t w = 0; w < threads_count; ++w) {
+            divisors_workers.emplace_back([this, &numbers, &worker_divisors, w]() {
+                size_t begin = numbers.size() * w / threads_count, end = numbers.size() * (w + 1) / threads_count;
+                for(size_t n = begin; n < end; ++n) findDivisors(numbers[n], worker_divisors[w]);
+            });
+        }
+        
+        for(thread& worker : divisors_workers) worker.join();
+        
+        // sorted list of divisors with relation to its multiples (possible second row numbers)
+        map<int, vector<int>, greater<int>> divisors;
+        
+        for(map<int, vector<int>, greater<int>>& worker_map : worker_divisors) {
+            for(auto& [divisor, multiples] : worker_map) {
+                vector<int>& all_multiples = divisors[divisor];
+                all_multiples.insert(all_multiples.end(), multiples.begin(), multiples.end());
+            }
+        }
+        
+        // ************************************************************************************
+        
+        // every (divisor, multiple) is searched as one or more ranges, in the order of the divisors, largest first
+        size_t searches_count = 0;
+        for(auto& [divisor, multiples] : divisors) searches_count += multiples.size();
+        
+        vector<MultipleSearch> searches(searches_count);
+        size_t s = 0;
+        
+        for(auto& [divisor, multiples] : divisors) {
+            for(int& multiple : multiples) {
+                searches[s].divisor = divisor;
+                searches[s].multiple = multiple;
+                s++;
+            }
+        }
+        
+        // a checkpoint of the same search skips the searches before its frontier, along with the grid one of them had
+        size_t first_search = 0, first_found_search = searches.size();
+        
+        if(resume_checkpoint) {
+            const SudokuCheckpoint& checkpoint = *resume_checkpoint;
+            const MultipleSearch* last = checkpoint.frontier > 0 && checkpoint.frontier <= searches.size() ? &searches[checkpoint.frontier - 1] : nullptr;
             
-                thread tUpward(bind(findCandidatesUpward, ref(multiple), ref(divisor), ref(max_number), ref(valid_candidates), ref(valid_candidates_len9), ref(valid_candidates_len8), ref(mtx)));
-                thread tDownward(bind(findCandidatesDownward, ref(multiple), ref(divisor), ref(min_number), ref(valid_candidates), ref(valid_candidates_len9), ref(valid_candidates_len8), ref(mtx)));
-                
-                tUpward.join();
-                tDownward.join();
-                
-                // ************************************************************************************
-                
-                if(multiple >= 100'000'000) {
-                    if(valid_candidates_len9 < 7 || valid_candidates_len8 < 1) continue;
-                } else {
-                    if(valid_candidates_len9 < 8) continue;
-                }
-                
-                if(any_of(valid_candidates.begin(), valid_candidates.end(), [](const vector<vector<uint8_t>>& a){return a.empty();})) continue;
+            if(checkpoint.searches_count == searches.size() && (checkpoint.frontier == 0 || (last && last->divisor == checkpoint.divisor && last->multiple == checkpoint.multiple))) {
+                first_search = checkpoint.frontier;
+                first_found_search = checkpoint.found_search;
+                answer = checkpoint.answer;
+            } else {
+                cerr << "The checkpoint doesn't match this search, starting over" << endl;
+            }
+        }
+        
+        vector<pair<size_t, size_t>> tasks;
+        
+        for(s = first_search; s < searches.size(); ++s) {
+            MultipleSearch& search = searches[s];
+            
+            search.ranges.resize(rangesCount(search.divisor, search.multiple));
+            search.remaining_ranges = search.ranges.size();
+            
+            for(size_t range = 0; range < search.ranges.size(); ++range) tasks.emplace_back(s, range);
+        }
+        
+        // ************************************************************************************
+        
+        /*
+         The workers live for the whole search and take the tasks in order. A grid found by a search only cancels the searches
+         after it, as the ones before it may still find a grid with a larger divisor, so the answer is the one of the first
+         search with a grid, as if they ran one by one. A range is small enough for the cancellation to wait for its end.
+         */
+        atomic<size_t> next_task{0}, found_search{first_found_search}, tasks_done{0};
+        mutex answer_mtx;
+        
+        auto runTasks = [this, &searches, &tasks, &next_task, &found_search, &tasks_done, &answer, &answer_mtx](const size_t& worker) {
+            WorkerCounters& counters = worker_counters[worker];
+            
+            for(size_t task = next_task++; task < tasks.size() && tasks[task].first < found_search.load(memory_order_relaxed); task = next_task++) {
+                auto [s, range] = tasks[task];
+                MultipleSearch& search = searches[s];
                 
-                // ************************************************************************************
+                counters.divisor.store(search.divisor, memory_order_relaxed);
+                findCandidates(search, range, counters);
+                tasks_done++;
                 
-                // find all the possible combinations of sudoku grids and validate them
-                vector<uint8_t> indices(9, 0);
-                int combinations = 1;
+                // the other ranges of the search are still running
+                if(search.remaining_ranges.fetch_sub(1, memory_order_acq_rel) != 1) continue;
                 
-                for (const auto& row : valid_candidates) combinations *= row.size();
+                counters.searches.add();
+                int search_answer = 0;
                 
-                for (int i = 0; i < combinations; i++) {
-                    vector<vector<uint8_t>> sudoku(9);
-                    
-                    for (int j = 0; j < 9; j++) sudoku[j] = valid_candidates[j][indices[j]];
-                    
-                    if(isValidSudoku(sudoku)) {
-                        int answer = 0, order = 1;
-                        for(uint8_t el : sudoku[4]) {
-                            answer += el * order;
-                            order *= 10;
-                        }
-                        
-                        cout << "Answer to the puzzle: " << answer << endl;
-                        
-//                        printSudoku(sudoku);
-                        return 1;
-                    }
+                if(assembleGrid(search, search_answer)) {
+                    lock_guard<mutex> lock(answer_mtx);
                     
-                    for (int j = 8; j >= 0; j--) {
-                        if (++indices[j] < valid_candidates[j].size()) break;
-                        indices[j] = 0;
+                    if(s < found_search) {
+                        found_search = s;
+                        answer = search_answer;
                     }
                 }
+                
+                search.finished.store(true, memory_order_release);
             }
+        };
+        
+        // ************************************************************************************
+        
+        // the frontier is only moved by the checkpoints, past the searches finished one after the other
+        size_t frontier = first_search;
+        
+        auto writeCheckpoint = [this, &searches, &frontier, &found_search, &answer, &answer_mtx]() {
+            while(frontier < searches.size() && searches[frontier].finished.load(memory_order_acquire)) frontier++;
+            
+            SudokuCheckpoint checkpoint;
+            checkpoint.givens = givensKey(givens);
+            checkpoint.searches_count = searches.size();
+            checkpoint.frontier = frontier;
+            
+            if(frontier > 0) {
+                checkpoint.divisor = searches[frontier - 1].divisor;
+                checkpoint.multiple = searches[frontier - 1].multiple;
+            }
+            
+            {
+                lock_guard<mutex> lock(answer_mtx);
+                checkpoint.found_search = found_search;
+                checkpoint.answer = answer;
+            }
+            
+            if(!writeSudokuCheckpoint(checkpoint_path, checkpoint)) cerr << "Failed to write checkpoint " << checkpoint_path << endl;
+        };
+        
+        {
+            PeriodicThread reporter(progress_interval_ms, [this, &searches, &tasks, &next_task, &tasks_done](const double& elapsed) {
+                if(tasks.empty()) return;
+                
+                size_t task = min<size_t>(next_task, tasks.size() - 1);
+                ostringstream line;
+                
+                writeProgress(line, elapsed, tasks_done, tasks.size(), searches[tasks[task].first].divisor);
+                cerr << line.str() << endl;
+            });
+            
+            PeriodicThread checkpointer(checkpoint_path.empty() ? 0 : checkpoint_interval_ms, [&writeCheckpoint](const double&) {
+                writeCheckpoint();
+            });
+            
+            vector<thread> workers;
+            for(size_t w = 0; w < threads_count; ++w) workers.emplace_back(runTasks, w);
+            for(thread& worker : workers) worker.join();
         }
         
-        return 0;
+        if(!checkpoint_path.empty()) writeCheckpoint();
+        
+        if(backend == GridBackend::COMPARE) {
+            cout << "Grids assembled: " << compared_grids << ", backends disagreed on " << disagreements << endl;
+            cout << "Backtracking: " << backtracking_time / 1'000'000.0 << " ms, DLX: " << dlx_time / 1'000'000.0 << " ms" << endl;
+        }
+        
+        return found_search != searches.size();
+    }
+    
+    // writes the frontier of the search to path every interval_ms and once it is over
+    void setCheckpoint(const string& path, const size_t& interval_ms) {
+        checkpoint_path = path;
+        checkpoint_interval_ms = interval_ms;
+    }
+    
+    // the search starts from the frontier of the checkpoint, if it is a checkpoint of the same search
+    void setResume(const SudokuCheckpoint* checkpoint) {
+        resume_checkpoint = checkpoint;
+    }
+    
+    // candidates stepped through or permuted by the searches so far
+    size_t getCandidatesCount() {
+        size_t r = 0;
+        for(const WorkerCounters& counters : worker_counters) r += counters.candidates.get();
+        
+        return r;
+    }
+    
+    // ************************************************************************************
+    
+    /*
+     Microbenchmarks of the kernels on fixed inputs: the digits of random numbers, their validation against a multiple,
+     the permutations of a multiple and the assembly of a grid hidden among random candidates by both backends.
+     */
+    void benchmarkKernels(const int& repeats) {
+        vector<int> numbers;
+        listSeedNumbers(8, 0, 0, numbers);
+        
+        int multiple = numbers[numbers.size() / 2];
+        mt19937 random(2025);
+        vector<int> stream(1 << 20);
+        
+        for(int& number : stream) number = MIN_NUMBER + random() % (MAX_NUMBER - MIN_NUMBER + 1);
+        
+        double seconds = timeBest(repeats, [&stream]() {
+            int mask = 0;
+            uint64_t packed = 0;
+            
+            for(const int& number : stream) benchmark_sink = benchmark_sink + packDigits(number, packed, mask);
+        });
+        
+        cout << "packDigits: " << stream.size() / seconds / 1e6 << " M numbers/s" << endl;
+        
+        seconds = timeBest(repeats, [this, &stream, &multiple]() {
+            CandidateBuffers buffers;
+            WorkerCounters counters;
+            for(const int& number : stream) validateCandidateAndAdd(multiple, number, buffers, counters);
+            
+            benchmark_sink = benchmark_sink + buffers.len9 + buffers.len8;
+        });
+        
+        cout << "validateCandidateAndAdd: " << stream.size() / seconds / 1e6 << " M candidates/s" << endl;
+        
+        size_t permuted_count = 0;
+        seconds = timeBest(repeats, [this, &multiple, &permuted_count]() {
+            CandidateBuffers buffers;
+            WorkerCounters counters;
+            permuted_count = findCandidatesPermuted(multiple, 7, buffers, counters);
+        });
+        
+        cout << "findCandidatesPermuted: " << permuted_count << " candidates, " << permuted_count / seconds / 1e6 << " M candidates/s" << endl;
+        
+        // ************************************************************************************
+        
+        // a valid grid out of the digits of the multiple, each of its rows after 64 random orders of the same digits
+        uint8_t digits[9];
+        int digits_mask = 0;
+        uint64_t packed = 0;
+        
+        packDigits(multiple, packed, digits_mask);
+        unpackDigits(packed, digits);
+        
+        vector<uint8_t> rows[9];
+        
+        for(uint8_t row = 0; row < 9; ++row) {
+            uint8_t row_digits[9];
+            
+            for(int decoy = 0; decoy < 64; ++decoy) {
+                copy(digits, digits + 9, row_digits);
+                shuffle(row_digits, row_digits + 9, random);
+                rows[row].insert(rows[row].end(), row_digits, row_digits + 9);
+            }
+            
+            for(uint8_t j = 0; j < 9; ++j) row_digits[j] = digits[(j + row % 3 * 3 + row / 3) % 9];
+            rows[row].insert(rows[row].end(), row_digits, row_digits + 9);
+        }
+        
+        const int grids_count = 100;
+        
+        seconds = timeBest(repeats, [this, &rows]() {
+            for(int grid = 0; grid < grids_count; ++grid) {
+                uint16_t columns[9] = {0}, boxes[9] = {0};
+                const uint8_t* sudoku[9] = {nullptr};
+                
+                benchmark_sink = benchmark_sink + placeRow(rows, 0, columns, boxes, sudoku);
+            }
+        });
+        
+        cout << "placeRow: " << grids_count / seconds << " grids/s" << endl;
+        
+        seconds = timeBest(repeats, [this, &rows, &digits_mask]() {
+            for(int grid = 0; grid < grids_count; ++grid) {
+                const uint8_t* sudoku[9] = {nullptr};
+                benchmark_sink = benchmark_sink + coverGrid(rows, digits_mask, sudoku);
+            }
+        });
+        
+        cout << "coverGrid: " << grids_count / seconds << " grids/s" << endl;
     }
     
 private:
-    int subsetToInt(vector<uint8_t>& subset, uint8_t& placements_count) {
-        int num = 0;
-
-        for(uint8_t i = 0; i < 4; ++i) num = num * 10 + subset[i];
+    size_t threads_count;
+    SudokuGivens givens;
+    GridBackend backend;
+    
+    // a JSON line of progress to stderr this often, 0 for none
+    size_t progress_interval_ms;
+    vector<WorkerCounters> worker_counters;
+    
+    string checkpoint_path;
+    size_t checkpoint_interval_ms = 0;
+    const SudokuCheckpoint* resume_checkpoint = nullptr;
+    
+    // totals of the COMPARE backend over all the grids it assembled, in nanoseconds
+    atomic<int64_t> backtracking_time{0}, dlx_time{0};
+    atomic<size_t> compared_grids{0}, disagreements{0};
+    
+    // stepping by the divisor visits fewer numbers than the permutations of the digits unless the divisor is small
+    static bool usePermutations(const int& divisor) {
+        return (MAX_NUMBER - MIN_NUMBER) / divisor > DIGITS_PERMUTATIONS;
+    }
+    
+    // the stepped numbers are multiple + k * divisor between MIN_NUMBER and MAX_NUMBER, from the smallest
+    static int firstStep(const int& multiple, const int& divisor) {
+        return multiple - (multiple - MIN_NUMBER) / divisor * divisor;
+    }
+    
+    static int stepsCount(const int& multiple, const int& divisor) {
+        return (MAX_NUMBER - firstStep(multiple, divisor)) / divisor + 1;
+    }
+    
+    // the permutations are bounded by 9! so they stay a single range
+    static size_t rangesCount(const int& divisor, const int& multiple) {
+        if(usePermutations(divisor)) return 1;
+        return (stepsCount(multiple, divisor) + RANGE_STEPS - 1) / RANGE_STEPS;
+    }
+    
+    // ************************************************************************************
+    
+    void findCandidates(MultipleSearch& search, const size_t& range, WorkerCounters& counters) {
+        if(usePermutations(search.divisor)) {
+            counters.candidates.add(findCandidatesPermuted(search.multiple, search.divisor, search.ranges[range], counters));
+        } else {
+            counters.candidates.add(findCandidatesStepping(search.multiple, search.divisor, range, search.ranges[range], counters));
+        }
+    }
+    
+    /*
+     One progress report: the tasks done and the time left at their pace, the divisor of the next task, and the counters
+     summed over the workers with the candidates of each of them. A grid found cancels the tasks after it, so the ETA is
+     the most the search can take.
+     */
+    void writeProgress(ostream& out, const double& elapsed, const size_t& tasks_done, const size_t& tasks_count, const int& divisor) {
+        size_t candidates = 0, searches = 0, short_rejects = 0, repeat_rejects = 0, digits_rejects = 0, column_rejects = 0, givens_rejects = 0;
+        size_t accepted[9] = {0};
+        ostringstream thread_candidates, thread_divisors, row_accepted;
         
-        // we know the position of 2 in second row number
-        num = num * 10 + 2;
-
-        for(uint8_t i = 4; i < placements_count; ++i) num = num * 10 + subset[i];
-
-        // the last position is 5 in second row number
-        return num * 10 + 5;
+        for(size_t w = 0; w < worker_counters.size(); ++w) {
+            const WorkerCounters& counters = worker_counters[w];
+            
+            candidates += counters.candidates.get();
+            searches += counters.searches.get();
+            short_rejects += counters.short_rejects.get();
+            repeat_rejects += counters.repeat_rejects.get();
+            digits_rejects += counters.digits_rejects.get();
+            column_rejects += counters.column_rejects.get();
+            givens_rejects += counters.givens_rejects.get();
+            for(uint8_t row = 0; row < 9; ++row) accepted[row] += counters.accepted[row].get();
+            
+            thread_candidates << (w ? "," : "") << counters.candidates.get();
+            thread_divisors << (w ? "," : "") << counters.divisor.load(memory_order_relaxed);
+        }
+        
+        for(uint8_t row = 0; row < 9; ++row) row_accepted << (row ? "," : "") << accepted[row];
+        
+        double eta = tasks_done ? elapsed * (tasks_count - tasks_done) / tasks_done : -1;
+        
+        out << fixed << setprecision(3) << "{\"elapsed_s\":" << elapsed << ",\"divisor\":" << divisor << ",\"tasks_done\":" << tasks_done << ",\"tasks_count\":" << tasks_count
+            << ",\"searches_done\":" << searches << ",\"candidates\":" << candidates << ",\"candidates_per_s\":" << (elapsed > 0 ? candidates / elapsed : 0)
+            << ",\"rejects\":{\"short\":" << short_rejects << ",\"repeat\":" << repeat_rejects << ",\"digits\":" << digits_rejects << ",\"column\":" << column_rejects << ",\"givens\":" << givens_rejects << "}"
+            << ",\"row_accepted\":[" << row_accepted.str() << "],\"thread_candidates\":[" << thread_candidates.str() << "],\"thread_divisors\":[" << thread_divisors.str() << "],\"eta_s\":" << eta << "}";
+    }
+    
+    // merges the buffers of all the ranges of the search, in order, and tries to assemble a grid out of them
+    bool assembleGrid(MultipleSearch& search, int& answer) {
+        CandidateBuffers candidates = move(search.ranges[0]);
+        
+        for(size_t range = 1; range < search.ranges.size(); ++range) {
+            CandidateBuffers& buffers = search.ranges[range];
+            
+            for(uint8_t row = 0; row < 9; ++row) candidates.rows[row].insert(candidates.rows[row].end(), buffers.rows[row].begin(), buffers.rows[row].end());
+            
+            candidates.len9 += buffers.len9;
+            candidates.len8 += buffers.len8;
+            buffers = CandidateBuffers();
+        }
+        
+        // ************************************************************************************
+        
+        // the multiple itself is the seed row
+        int mask_multiple = 0;
+        uint64_t packed_multiple = 0;
+        uint8_t digits_multiple[9];
+        
+        packDigits(search.multiple, packed_multiple, mask_multiple);
+        
+        // a grid with 0 has one 8 digits number, the one with 0 in its first column
+        if(search.multiple >= 100'000'000 && (mask_multiple & 1)) {
+            if(candidates.len9 < 7 || candidates.len8 < 1) return false;
+        } else {
+            if(candidates.len9 < 8) return false;
+        }
+        
+        unpackDigits(packed_multiple, digits_multiple);
+        candidates.rows[givens.seed_row].insert(candidates.rows[givens.seed_row].end(), digits_multiple, digits_multiple + 9);
+        
+        if(any_of(begin(candidates.rows), end(candidates.rows), [](const vector<uint8_t>& a){return a.empty();})) return false;
+        
+        // ************************************************************************************
+        
+        const uint8_t* sudoku[9] = {nullptr};
+        if(!assembleRows(candidates.rows, mask_multiple, sudoku)) return false;
+        
+        int order = 1;
+        for(uint8_t j = 0; j < 9; ++j) {
+            answer += sudoku[4][j] * order;
+            order *= 10;
+        }
+        
+//        printSudoku(sudoku);
+        return true;
+    }
+    
+    /*
+     The numbers the seed row can hold, built from the first column with the digits in increasing order. They have 9 of
+     the 10 digits, all the given ones among them, and fit the givens of the row.
+     */
+    void listSeedNumbers(const int8_t& j, const int& used_mask, const int& number, vector<int>& numbers) {
+        if(j < 0) {
+            if((used_mask & givens.digits_mask) == givens.digits_mask) numbers.push_back(number);
+            return;
+        }
+        
+        int8_t given = givens.cells[givens.seed_row][8 - j];
+        
+        for(uint8_t digit = 0; digit < 10; ++digit) {
+            if((used_mask & (1 << digit)) || (given >= 0 && digit != given) || (givens.forbidden[givens.seed_row] & cellBit(j, digit))) continue;
+            
+            listSeedNumbers(j - 1, used_mask | (1 << digit), number * 10 + digit, numbers);
+        }
     }
     
     void findDivisors(int& num, map<int, vector<int>, greater<int>>& divisors) {
         int max_i = sqrt(num);
 
-        for(int i = 1; i <= max_i; ++i) {
-            if(num % i == 0) {
-                int div = num / i;
-                
-                // one of the sudoku numbers is 8 digits length as we have 0 in it, so divisor can not be 9 digits
-                if(div > 99'999'999 || i > 99'999'999) continue;
-                
-                int dr = div % 10;
-                
-                // divisor must end with 1,3,7,9 as we need 9 sudoku numbers be odd and even
-                if(dr == 1 || dr == 3 || dr == 7 || dr == 9) divisors[div].push_back(num);
-                if(i == 1  || i == 3  || i == 7  || i == 9 ) divisors[i].push_back(num);
-            }
+        for(const int& i : listDivisors(num)) {
+            if(i > max_i) break;
+            
+            int div = num / i;
+            
+            // one of the sudoku numbers is 8 digits length as we have 0 in it, so divisor can not be 9 digits
+            if(div > 99'999'999 || i > 99'999'999) continue;
+            
+            int dr = div % 10;
+            
+            // divisor must end with 1,3,7,9 as we need 9 sudoku numbers be odd and even
+            if(dr == 1 || dr == 3 || dr == 7 || dr == 9) divisors[div].push_back(num);
+            if(i == 1  || i == 3  || i == 7  || i == 9 ) divisors[i].push_back(num);
         }
     }
     
-    static void findCandidatesUpward(int& multiple, int& divisor, int& max_number, vector<vector<vector<uint8_t>>>& valid_candidates, size_t& valid_candidates_len9, size_t&valid_candidates_len8, mutex& mtx) {
-        int from = multiple + divisor;
-        for(int candidate = from; candidate <= max_number; candidate += divisor) {
-            if(validateCandidateAndAdd(multiple, candidate, valid_candidates, mtx)) {
-                lock_guard<mutex> lock(mtx);
-                candidate >= 100'000'000 ? valid_candidates_len9++ : valid_candidates_len8++;
+    // all divisors of a number in increasing order, built from its prime factorization
+    static vector<int> listDivisors(int number) {
+        vector<int> r = {1};
+        
+        for(const int& prime : PRIMES) {
+            if(prime * prime > number) break;
+            if(number % prime != 0) continue;
+            
+            size_t count = r.size();
+            int power = 1;
+            
+            while(number % prime == 0) {
+                number /= prime;
+                power *= prime;
+                
+                for(size_t d = 0; d < count; ++d) r.push_back(r[d] * power);
             }
         }
+        
+        // what is left is a prime above the square root
+        if(number > 1) {
+            size_t count = r.size();
+            for(size_t d = 0; d < count; ++d) r.push_back(r[d] * number);
+        }
+        
+        sort(r.begin(), r.end());
+        return r;
     }
     
-    static void findCandidatesDownward(int& multiple, int& divisor, int& min_number, vector<vector<vector<uint8_t>>>& valid_candidates, size_t& valid_candidates_len9, size_t&valid_candidates_len8, mutex& mtx) {
-        int from = multiple - divisor;
-        for(int candidate = from; candidate >= min_number; candidate -= divisor) {
-            if(validateCandidateAndAdd(multiple, candidate, valid_candidates, mtx)) {
-                lock_guard<mutex> lock(mtx);
-                candidate >= 100'000'000 ? valid_candidates_len9++ : valid_candidates_len8++;
-            }
+    // returns the number of candidates stepped through
+    size_t findCandidatesStepping(const int& multiple, const int& divisor, const size_t& range, CandidateBuffers& buffers, WorkerCounters& counters) {
+        int begin = range * RANGE_STEPS, end = min(stepsCount(multiple, divisor), begin + RANGE_STEPS);
+        int candidate = firstStep(multiple, divisor) + begin * divisor;
+        
+        for(int step = begin; step < end; ++step, candidate += divisor) validateCandidateAndAdd(multiple, candidate, buffers, counters);
+        return end - begin;
+    }
+    
+    /*
+     A candidate has the digits of the multiple and none of them in the same position, so instead of stepping through
+     the multiples of the divisor we can build these orders of the digits, from the last one, and test the divisibility.
+     */
+    size_t findCandidatesPermuted(const int& multiple, const int& divisor, CandidateBuffers& buffers, WorkerCounters& counters) {
+        int mask_multiple = 0;
+        uint64_t packed_multiple = 0;
+        
+        packDigits(multiple, packed_multiple, mask_multiple);
+        return permuteCandidates(multiple, divisor, packed_multiple, 0, mask_multiple, 0, 1, buffers, counters);
+    }
+    
+    // returns the number of orders of the digits built
+    size_t permuteCandidates(const int& multiple, const int& divisor, const uint64_t& packed_multiple, const uint8_t& position, const int& remaining_mask, const int& candidate, const int& order, CandidateBuffers& buffers, WorkerCounters& counters) {
+        if(position == 9) {
+            if(candidate % divisor == 0) validateCandidateAndAdd(multiple, candidate, buffers, counters);
+            return 1;
         }
+        
+        size_t count = 0;
+        
+        for(uint8_t digit = 0; digit < 10; ++digit) {
+            if(!(remaining_mask & (1 << digit)) || digit == ((packed_multiple >> (position * 4)) & 0xF)) continue;
+            
+            count += permuteCandidates(multiple, divisor, packed_multiple, position + 1, remaining_mask ^ (1 << digit), candidate + digit * order, order * 10, buffers, counters);
+        }
+        
+        return count;
     }
     
-    static bool validateCandidateAndAdd(int& multiple, int& candidate, vector<vector<vector<uint8_t>>>& valid_candidates, mutex& mtx) {
+    bool validateCandidateAndAdd(const int& multiple, const int& candidate, CandidateBuffers& buffers, WorkerCounters& counters) {
         // both nunbers are 8 digits in length which can not be in sudoku grid
-        if(multiple < 100'000'000 && candidate < 100'000'000) return false;
+        if(multiple < 100'000'000 && candidate < 100'000'000) {
+            counters.short_rejects.add();
+            return false;
+        }
         
         // ************************************************************************************
         
         int mask_multiple = 0, mask_candidate = 0;
-        vector<uint8_t> digits_multiple, digits_candidate;
-
-        digits_multiple.reserve(9);
-        digits_candidate.reserve(9);
+        uint64_t packed_multiple = 0, packed_candidate = 0;
         
         // ************************************************************************************
         
-        if(!extractDigits(candidate, mask_candidate, digits_candidate, true)) return false;
-        extractDigits(multiple, mask_multiple, digits_multiple);
+        if(!packDigits(candidate, packed_candidate, mask_candidate)) {
+            counters.repeat_rejects.add();
+            return false;
+        }
+        
+        packDigits(multiple, packed_multiple, mask_multiple);
         
         // ************************************************************************************
         
-        if(mask_multiple != mask_candidate) return false;
-        for(int i = 0; i < 9; ++i) if(digits_multiple[i] == digits_candidate[i]) return false;
+        if(mask_multiple != mask_candidate) {
+            counters.digits_rejects.add();
+            return false;
+        }
+        
+        if(hasSharedDigit(packed_multiple, packed_candidate)) {
+            counters.column_rejects.add();
+            return false;
+        }
         
         // ************************************************************************************
         
-        uint8_t row_index = 4;
+        uint8_t digits_candidate[9];
+        unpackDigits(packed_candidate, digits_candidate);
         
-        // validation rules for the digits we have in the grid
-        // 1, 3, 6, 8 rows
-        if(digits_candidate[1] == 2 || digits_candidate[3] == 2 || digits_candidate[5] == 2 || digits_candidate[7] == 2) {
-            if(digits_candidate[2] == 5 || digits_candidate[4] == 0 || digits_candidate[6] == 0) return false;
-            
-            if(digits_candidate[1] == 2) row_index = 0;
-            if(digits_candidate[3] == 2) row_index = 7;
-            if(digits_candidate[5] == 2) row_index = 5;
-            if(digits_candidate[7] == 2) row_index = 2;
-        }
+        CellsMask cells = 0;
+        for(uint8_t j = 0; j < 9; ++j) cells |= cellBit(j, digits_candidate[j]);
         
-        // 9 row
-        if(digits_candidate[2] == 5) {
-            if(digits_candidate[1] == 2 || digits_candidate[3] == 2 || digits_candidate[5] == 2 || digits_candidate[7] == 2 || digits_candidate[4] == 0 || digits_candidate[6] == 0) return false;
+        // the rows whose givens the candidate fits, a row without givens only rules out the cells forbidden to it
+        bool fits = false;
+        
+        for(uint8_t row = 0; row < 9; ++row) {
+            if(row == givens.seed_row || (cells & givens.required[row]) != givens.required[row] || (cells & givens.forbidden[row])) continue;
             
-            row_index = 8;
+            buffers.rows[row].insert(buffers.rows[row].end(), digits_candidate, digits_candidate + 9);
+            counters.accepted[row].add();
+            fits = true;
         }
-
-        // 4 and 7 rows
-        if(digits_candidate[4] == 0 || digits_candidate[6] == 0) {
-            if(digits_candidate[1] == 2 || digits_candidate[3] == 2 || digits_candidate[5] == 2 || digits_candidate[7] == 2 || digits_candidate[2] == 5) return false;
-            
-            if(digits_candidate[4] == 0) row_index = 6;
-            if(digits_candidate[6] == 0) row_index = 3;
+        
+        if(!fits) {
+            counters.givens_rejects.add();
+            return false;
         }
         
+        candidate >= 100'000'000 ? buffers.len9++ : buffers.len8++;
+        return true;
+    }
+    
+    // packs the 9 digits of a number from the last one with 3 table lookups, returns false if a digit repeats
+    static bool packDigits(const int& number, uint64_t& packed, int& mask) {
+        const DigitsGroup& low = DIGITS_GROUPS[number % 1000];
+        const DigitsGroup& middle = DIGITS_GROUPS[number / 1000 % 1000];
+        const DigitsGroup& high = DIGITS_GROUPS[number / 1'000'000];
+        
+        packed = low.packed | uint64_t(middle.packed) << 12 | uint64_t(high.packed) << 24;
+        mask = low.mask | middle.mask | high.mask;
+        
+        return low.mask && middle.mask && high.mask && __builtin_popcount(mask) == 9;
+    }
+    
+    // whether the numbers have the same digit in some position, a 0 digit of their difference found by a SWAR check
+    static bool hasSharedDigit(const uint64_t& packed_a, const uint64_t& packed_b) {
+        uint64_t difference = packed_a ^ packed_b;
+        return (difference - PACKED_DIGITS_LOW) & ~difference & PACKED_DIGITS_HIGH;
+    }
+    
+    static void unpackDigits(const uint64_t& packed, uint8_t (&digits)[9]) {
+        for(uint8_t i = 0; i < 9; ++i) digits[i] = (packed >> (i * 4)) & 0xF;
+    }
+    
+    bool assembleRows(const vector<uint8_t> (&rows)[9], const int& digits_mask, const uint8_t* (&sudoku)[9]) {
+        uint16_t columns[9] = {0}, boxes[9] = {0};
+        
+        if(backend == GridBackend::BACKTRACKING) return placeRow(rows, 0, columns, boxes, sudoku);
+        if(backend == GridBackend::DLX) return coverGrid(rows, digits_mask, sudoku);
+        
         // ************************************************************************************
         
-        lock_guard<mutex> lock(mtx);
-        if(valid_candidates[1].empty()) valid_candidates[1].push_back(digits_multiple);
+        const uint8_t* dlx_sudoku[9] = {nullptr};
         
-        valid_candidates[row_index].push_back(digits_candidate);
-        return true;
+        auto start = chrono::steady_clock::now();
+        bool placed = placeRow(rows, 0, columns, boxes, sudoku);
+        auto middle = chrono::steady_clock::now();
+        bool covered = coverGrid(rows, digits_mask, dlx_sudoku);
+        auto end = chrono::steady_clock::now();
+        
+        backtracking_time += chrono::duration_cast<chrono::nanoseconds>(middle - start).count();
+        dlx_time += chrono::duration_cast<chrono::nanoseconds>(end - middle).count();
+        compared_grids++;
+        if(placed != covered) disagreements++;
+        
+        return placed;
     }
     
-    static bool extractDigits(int number, int& mask, vector<uint8_t>& digits, bool check_uniqueness = false) {
-        while(number > 0) {
-            int digit = number % 10;
-            
-            // number has non unique digits
-            if(check_uniqueness) if(mask & (1 << digit)) return false;
-
-            mask |= (1 << digit);
-            digits.push_back(digit);
-
-            number /= 10;
-        }
+    /*
+     The grid as an exact cover: every row slot takes one candidate, and every column and box has each of the 9 digits
+     of the grid once. A candidate of a row is an option covering its slot, its 9 column-digit items and 9 box-digit items.
+     */
+    bool coverGrid(const vector<uint8_t> (&rows)[9], const int& digits_mask, const uint8_t* (&sudoku)[9]) {
+        const size_t slot_items = 1, column_items = slot_items + 9, box_items = column_items + 81;
+        
+        // the rank of every digit among the digits of the grid
+        uint8_t digit_ranks[10] = {0};
+        for(uint8_t digit = 0, rank = 0; digit < 10; ++digit) if(digits_mask & (1 << digit)) digit_ranks[digit] = rank++;
         
-        if(digits.size() == 8) {
-            mask |= (1 << 0);
-            digits.push_back(0);
+        DancingLinks links(box_items + 81 - 1);
+        vector<const uint8_t*> options;
+        vector<uint8_t> option_rows;
+        vector<size_t> items(19);
+        
+        for(uint8_t row = 0; row < 9; ++row) {
+            for(size_t c = 0; c < rows[row].size(); c += 9) {
+                const uint8_t* candidate = &rows[row][c];
+                
+                items[0] = slot_items + row;
+                for(uint8_t j = 0; j < 9; ++j) {
+                    items[1 + j] = column_items + j * 9 + digit_ranks[candidate[j]];
+                    items[10 + j] = box_items + (row / 3 * 3 + j / 3) * 9 + digit_ranks[candidate[j]];
+                }
+                
+                links.addOption(items);
+                options.push_back(candidate);
+                option_rows.push_back(row);
+            }
         }
         
+        vector<int> solution;
+        if(!links.search(solution)) return false;
+        
+        for(const int& o : solution) sudoku[option_rows[o]] = options[o];
         return true;
     }
     
-    bool isValidSudoku(vector<vector<uint8_t>>& sudoku) {
-        bool rows[9][10] = {false};
-        bool cols[9][10] = {false};
-        bool subs[9][10] = {false};
+    /*
+     Backtracking over the rows, top to bottom. columns and boxes hold a bit for every digit already placed in them,
+     a candidate never repeats a digit so its own row needs no mask. The digits of a candidate are stored from the
+     last column, which mirrors the boxes of a band but keeps them apart all the same.
+     */
+    bool placeRow(const vector<uint8_t> (&rows)[9], const uint8_t& row, uint16_t (&columns)[9], uint16_t (&boxes)[9], const uint8_t* (&sudoku)[9]) {
+        if(row == 9) return true;
+        
+        uint16_t* band_boxes = &boxes[row / 3 * 3];
         
-        for(uint8_t i = 0; i < 9; ++i) {
+        for(size_t c = 0; c < rows[row].size(); c += 9) {
+            const uint8_t* candidate = &rows[row][c];
+            bool conflict = false;
+            
+            for(uint8_t j = 0; j < 9 && !conflict; ++j) conflict = (columns[j] | band_boxes[j / 3]) & (1 << candidate[j]);
+            if(conflict) continue;
+            
             for(uint8_t j = 0; j < 9; ++j) {
-                uint8_t s = i / 3 * 3 + j / 3, num = sudoku[i][j];
-                
-                if(rows[i][num] || cols[j][num] || subs[s][num]) return false;
-
-                rows[i][num] = cols[j][num] = subs[s][num] = true;
+                columns[j] |= 1 << candidate[j];
+                band_boxes[j / 3] |= 1 << candidate[j];
+            }
+            
+            sudoku[row] = candidate;
+            if(placeRow(rows, row + 1, columns, boxes, sudoku)) return true;
+            
+            for(uint8_t j = 0; j < 9; ++j) {
+                columns[j] ^= 1 << candidate[j];
+                band_boxes[j / 3] ^= 1 << candidate[j];
             }
         }
         
-        return true;
+        return false;
     }
     
-    void printSudoku(vector<vector<uint8_t>>& sudoku) {
-        for(vector<uint8_t>& row : sudoku) reverse(row.begin(), row.end());
-        
+    void printSudoku(const uint8_t* (&sudoku)[9]) {
         cout << "-------------------------" << endl;
         for (int i = 0; i < 9; ++i) {
             cout << "| ";
             for (int j = 0; j < 9; ++j) {
-                cout << (int)sudoku[i][j] << " ";
+                cout << (int)sudoku[i][8 - j] << " ";
                 if ((j + 1) % 3 == 0) cout << "| ";
             }
             
@@ -291,8 +1204,104 @@ private:
 
 // ************************************************************************************
 
+string getStringOption(int argc, const char * argv[], const string& option, const string& default_value) {
+    for(int i = 1; i + 1 < argc; ++i) {
+        if(argv[i] == option) return argv[i + 1];
+    }
+    
+    return default_value;
+}
+
+int getOption(int argc, const char * argv[], const string& option, const int& default_value) {
+    string value = getStringOption(argc, argv, option, "");
+    return value.empty() ? default_value : stoi(value);
+}
+
+// number of worker threads, can be overridden with --threads N to measure the scaling
+size_t getThreadsCount(int argc, const char * argv[]) {
+    return max(getOption(argc, argv, "--threads", thread::hardware_concurrency()), 1);
+}
+
+bool hasFlag(int argc, const char * argv[], const string& flag) {
+    for(int i = 1; i < argc; ++i) if(argv[i] == flag) return true;
+    return false;
+}
+
+/*
+ The kernels on fixed inputs, then the solver end to end from 1 thread up to threads_max, doubling.
+ Run with --benchmark, every figure is the best of --benchmark-repeats runs.
+ */
+void runBenchmarks(const SudokuGivens& givens, const GridBackend& backend, const size_t& threads_max, const int& repeats) {
+    cout << fixed << setprecision(3);
+    
+    SomewhatSquareSudoku(givens, backend, 1).benchmarkKernels(repeats);
+    
+    double single_thread_seconds = 0;
+    
+    for(size_t threads_count = 1; threads_count <= threads_max; threads_count = threads_count < threads_max ? min(threads_count * 2, threads_max) : threads_count + 1) {
+        size_t candidates_count = 0;
+        
+        double seconds = timeBest(repeats, [&givens, &backend, &threads_count, &candidates_count]() {
+            SomewhatSquareSudoku sudoku(givens, backend, threads_count);
+            int answer = 0;
+            
+            sudoku.solve(answer);
+            candidates_count = sudoku.getCandidatesCount();
+        });
+        
+        if(threads_count == 1) single_thread_seconds = seconds;
+        
+        cout << "solve, " << threads_count << " threads: " << seconds * 1000 << " ms, " << candidates_count / seconds / 1e6 << " M candidates/s, speedup " << single_thread_seconds / seconds << endl;
+    }
+}
+
 int main(int argc, const char * argv[]) {
     
-    SomewhatSquareSudoku sudoku;
-    return sudoku.solve();
+    // --givens PATH solves the puzzle with the givens of a file instead of the ones of this puzzle
+    string givens_path = getStringOption(argc, argv, "--givens", "");
+    SudokuGivens givens;
+    
+    if(givens_path.empty() ? !compileGivens(PUZZLE_GIVENS, givens) : !loadGivens(givens_path, givens)) {
+        cout << "Failed to read givens from " << (givens_path.empty() ? "the puzzle" : givens_path) << endl;
+        return 1;
+    }
+    
+    // --backend dlx assembles the grids as an exact cover, --backend compare runs both backends and times them
+    string backend = getStringOption(argc, argv, "--backend", "backtracking");
+    
+    GridBackend grid_backend = backend == "dlx" ? GridBackend::DLX : backend == "compare" ? GridBackend::COMPARE : GridBackend::BACKTRACKING;
+    
+    // --benchmark times the kernels and the solver up to --threads workers
+    if(hasFlag(argc, argv, "--benchmark")) {
+        runBenchmarks(givens, grid_backend, getThreadsCount(argc, argv), max(getOption(argc, argv, "--benchmark-repeats", 3), 1));
+        return 0;
+    }
+    
+    // --progress MS writes the counters of the search to stderr as a JSON line every MS milliseconds
+    SomewhatSquareSudoku sudoku(givens, grid_backend, getThreadsCount(argc, argv), max(getOption(argc, argv, "--progress", 0), 0));
+    
+    /*
+     --checkpoint PATH writes the frontier of the search to PATH every --checkpoint-interval seconds (60 by default)
+     and once it is over, --resume starts from the checkpoint of PATH instead of the first divisor
+     */
+    string checkpoint_path = getStringOption(argc, argv, "--checkpoint", "");
+    sudoku.setCheckpoint(checkpoint_path, max(getOption(argc, argv, "--checkpoint-interval", 60), 1) * 1000);
+    
+    SudokuCheckpoint checkpoint;
+    
+    if(hasFlag(argc, argv, "--resume")) {
+        if(!readSudokuCheckpoint(checkpoint_path, checkpoint) || checkpoint.givens != givensKey(givens)) {
+            cout << "Failed to resume from checkpoint " << checkpoint_path << endl;
+            return 1;
+        }
+        
+        sudoku.setResume(&checkpoint);
+    }
+    
+    int answer = 0;
+    
+    if(!sudoku.solve(answer)) return 0;
+    
+    cout << "Answer to the puzzle: " << answer << endl;
+    return 1;
 }